@@ -1,12 +1,24 @@
 // Copyright 2021 Fedor Teleshov <fdrt29@gmail.com>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <regex>
+#include <sstream>
 #include <stack>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 template <class K, class V>
 class IBinaryTree {
@@ -27,24 +39,32 @@ class IBinaryTree {
 
 template <class Key, class Value>
 class BinaryTree : IBinaryTree<Key, Value> {
+ protected:
   struct Node {
     Key key;
     Value value;
     Node *parent;
     Node *left;
     Node *right;
+    bool pooled;  // Lives in one of BinaryTree::pools_, not owned by new
 
-    Node(Key key_p, Value value_p, Node *parent_p) noexcept
+    Node(Key key_p, Value value_p, Node *parent_p,
+         bool pooled_p = false) noexcept
         : key(key_p),
           value(std::move(value_p)),
           parent(parent_p),
           left(nullptr),
-          right(nullptr) {}
+          right(nullptr),
+          pooled(pooled_p) {}
 
-    ~Node() {
-      delete left;
-      delete right;
-    }
+    template <class... Args>
+    Node(Key key_p, Node *parent_p, std::in_place_t, Args &&...args)
+        : key(key_p),
+          value(std::forward<Args>(args)...),
+          parent(parent_p),
+          left(nullptr),
+          right(nullptr),
+          pooled(false) {}
 
     void Clear() {
       left = nullptr;
@@ -80,80 +100,87 @@ class BinaryTree : IBinaryTree<Key, Value> {
 
  public:
   BinaryTree() : root_() {}
-  ~BinaryTree() override { delete root_; }
+  ~BinaryTree() override { Clear(); }
+  BinaryTree(const BinaryTree &) = delete;
+  BinaryTree &operator=(const BinaryTree &) = delete;
 
  public:
   //  TODO ? при вставке ноды с уже имеющимся ключом нужно выводить error =>
   //  throw or bool. Вообще в тестах ошибка была при set вроде
-  void Add(Key key, const Value &value) override {
-    if (not root_) {
-      root_ = new Node(key, value, nullptr);
+  void Add(Key key, const Value &value) override { Emplace(key, value); }
+  void Add(Key key, Value &&value) { Emplace(key, std::move(value)); }
+
+  // Значение конструируется прямо в узле из args, без промежуточных копий.
+  // Если ключ уже есть - значение перезаписывается, как в Add.
+  template <class... Args>
+  void Emplace(Key key, Args &&...args) {
+    Node *parent = nullptr;
+    Node **slot = FindSlot(key, parent);
+    if (*slot) {
+      (*slot)->value = Value(std::forward<Args>(args)...);
+      OnAccess(*slot);
       return;
     }
-    SearchPlaceForKey(
-        key,
-        [&key, &value](Node *current) {
-          if (current->left == nullptr)
-            current->left = new Node(key, value, current);
-        },
-        [&key, &value](Node *current) {
-          if (current->right == nullptr)
-            current->right = new Node(key, value, current);
-        },
-        [&value](Node *current) { current->value = value; });
+    *slot = new Node(key, parent, std::in_place, std::forward<Args>(args)...);
+    OnAccess(*slot);
     // TODO mb i should add node with equal Key to one
     // side(e.g. left). Don't rotate when you have equal nodes!
     // Traverse down to the next level and rotate that!
   }
 
+  // Как Emplace, но значение уже имеющегося ключа не меняется (узел все равно
+  // передается в OnAccess). false, если ключ уже был
+  template <class... Args>
+  bool TryEmplace(Key key, Args &&...args) {
+    Node *parent = nullptr;
+    Node **slot = FindSlot(key, parent);
+    if (*slot) {
+      OnAccess(*slot);
+      return false;
+    }
+    *slot = new Node(key, parent, std::in_place, std::forward<Args>(args)...);
+    OnAccess(*slot);
+    return true;
+  }
+
   void Set(Key key, const Value &value) override {
-    SearchPlaceForKey(key, nullptr, nullptr,
-                      [&value](Node *current) { current->value = value; });
+    if (Node *node = AccessNode(key)) node->value = value;
+  }
+  void Set(Key key, Value &&value) {
+    if (Node *node = AccessNode(key)) node->value = std::move(value);
   }
 
   void Delete(Key key) override {
-    if (root_ == nullptr) return;
-    SearchPlaceForKey(key, nullptr, nullptr, [](Node *current) {
-      if (current->left and current->right) {  // if node haven both children
-        // Swap current with max in left subtree
-        Node *maxNode = Node::Max(current->left);
-        std::swap(maxNode->key, current->key);
-        // MaxNode in the left subtree can have a child (only left)
-        // Replace ptr in maxNode's parent
-        // Using pointer-to-member, just for practice
-        maxNode->parent->*maxNode->PositionInParent() = maxNode->left;
-        maxNode->Clear();
-        delete maxNode;
-
-      } else if (current->left) {
-        current->left->parent = current->parent;
-        current->parent->*current->PositionInParent() = current->left;
-        current->Clear();
-        delete current;
-
-      } else if (current->right) {
-        current->right->parent = current->parent;
-        current->parent->*current->PositionInParent() = current->right;
-        current->Clear();
-        delete current;
-
-      } else {  // if node haven't children
-        current->parent->*current->PositionInParent() = nullptr;
-        current->Clear();
-        delete current;
-      }
-    });
+    if (Node *node = AccessNode(key)) RemoveNode(node);
+  }
+
+  // Удаление с перемещением значения наружу, std::nullopt если ключа нет
+  std::optional<Value> Extract(Key key) {
+    Node *node = AccessNode(key);
+    if (not node) return std::nullopt;
+    std::optional<Value> value(std::move(node->value));
+    RemoveNode(node);
+    return value;
   }
 
   [[nodiscard]] Value Search(Key key) const override {
-    SearchPlaceForKey(key, nullptr, nullptr,
-                      [](Node *current) { return current->value; });
-    return Value();
+    const Value *value = Find(key);
+    return value ? *value : Value();
+  }
+
+  // Доступ без копирования, nullptr если ключа нет
+  [[nodiscard]] Value *Find(Key key) {
+    Node *node = AccessNode(key);
+    return node ? &node->value : nullptr;
+  }
+  [[nodiscard]] const Value *Find(Key key) const {
+    Node *node = FindNode(key);
+    return node ? &node->value : nullptr;
   }
 
   // TODO mb use KeyValuePair
   [[nodiscard]] std::pair<Key, Value> Min() const override {
-    if (root_ == nullptr) std::pair<Key, Value>();
+    if (root_ == nullptr) return std::pair<Key, Value>();
     Node *current = root_;
     while (true) {
       if (current->left == nullptr) {
@@ -164,14 +191,105 @@ class BinaryTree : IBinaryTree<Key, Value> {
   }
   // TODO clarify the interaction between the Node::Max function and this
   [[nodiscard]] std::pair<Key, Value> Max() const override {
-    if (root_ == nullptr) std::pair<Key, Value>();
+    if (root_ == nullptr) return std::pair<Key, Value>();
+    return std::make_pair(Node::Max(root_)->key, Node::Max(root_)->value);
+  }
+
+  // Min/Max по ссылкам, std::nullopt для пустого дерева
+  [[nodiscard]] std::optional<std::pair<const Key &, const Value &>> FindMin()
+      const {
+    if (root_ == nullptr) return std::nullopt;
     Node *current = root_;
-    while (true) {
-      if (current->right == nullptr) {
-        return std::make_pair(current->key, current->value);
+    while (current->left) current = current->left;
+    return std::pair<const Key &, const Value &>(current->key, current->value);
+  }
+  [[nodiscard]] std::optional<std::pair<const Key &, const Value &>> FindMax()
+      const {
+    if (root_ == nullptr) return std::nullopt;
+    Node *current = Node::Max(root_);
+    return std::pair<const Key &, const Value &>(current->key, current->value);
+  }
+  // То же с передачей найденного узла в OnAccess
+  std::optional<std::pair<const Key &, const Value &>> FindMin() {
+    if (root_ == nullptr) return std::nullopt;
+    Node *current = root_;
+    while (current->left) current = current->left;
+    OnAccess(current);
+    return std::pair<const Key &, const Value &>(current->key, current->value);
+  }
+  std::optional<std::pair<const Key &, const Value &>> FindMax() {
+    if (root_ == nullptr) return std::nullopt;
+    Node *current = Node::Max(root_);
+    OnAccess(current);
+    return std::pair<const Key &, const Value &>(current->key, current->value);
+  }
+
+  /* Построение сбалансированного дерева из отсортированной последовательности.
+   * Элементы - пары (ключ, значение) по возрастанию ключа, при равных ключах
+   * остается последнее значение (как при повторном Add). Старое содержимое
+   * удаляется.
+   *
+   * По времени: O(n) - каждый узел создается и связывается один раз, вместо
+   * O(n^2) при поочередном Add отсортированных ключей (вырожденное дерево).
+   * По памяти: O(n), узлы лежат в одном непрерывном блоке в порядке in-order.
+   * */
+  template <class Iterator>
+  void BuildFromSorted(Iterator first, Iterator last) {
+    Clear();
+    std::vector<Node> pool;
+    using Category = typename std::iterator_traits<Iterator>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>)
+      pool.reserve(std::distance(first, last));
+    for (; first != last; ++first) {
+      const auto &[key, value] = *first;
+      if (not pool.empty() and not(pool.back().key < key)) {
+        pool.back().value = value;
+        continue;
       }
-      current = current->right;
+      pool.emplace_back(key, value, nullptr, true);
+    }
+    if (pool.empty()) return;
+    pools_.push_back(std::move(pool));
+    std::vector<Node> &nodes = pools_.back();
+    root_ = LinkSorted(nodes, 0, nodes.size(), nullptr);
+  }
+
+  template <class Range>
+  void BuildFromSorted(const Range &range) {
+    BuildFromSorted(std::begin(range), std::end(range));
+  }
+
+  /* Балансировка алгоритмом Day-Stout-Warren.
+   * Дерево разворачивается в "лозу" (список по правым ссылкам) правыми
+   * поворотами, затем сворачивается левыми поворотами в дерево высоты
+   * ceil(log2(n + 1)). Узлы не перевыделяются.
+   *
+   * По времени: O(n). По памяти: O(1), не считая стека при восстановлении
+   * ссылок на родителей (O(log n) после балансировки).
+   * */
+  void Rebalance() {
+    size_t size = TreeToVine();
+    if (size == 0) return;
+    size_t full = 1;  // Nodes in the largest perfect tree <= size
+    while (full * 2 + 1 <= size) full = full * 2 + 1;
+    Compress(size - full);
+    for (size = full; size > 1; size /= 2) Compress(size / 2);
+    FixParents();
+  }
+
+  void Clear() {
+    // Iterative, because a degenerate tree would overflow the call stack
+    std::stack<Node *> stack;
+    if (root_) stack.push(root_);
+    while (not stack.empty()) {
+      Node *node = stack.top();
+      stack.pop();
+      if (node->left) stack.push(node->left);
+      if (node->right) stack.push(node->right);
+      if (not node->pooled) delete node;
     }
+    root_ = nullptr;
+    pools_.clear();
   }
 
   void LevelOrderTraversal(
@@ -201,48 +319,584 @@ class BinaryTree : IBinaryTree<Key, Value> {
 
   [[nodiscard]] bool Empty() const { return root_ == nullptr; }
 
- public:
-  friend std::ostream &operator<<(std::ostream &out, const BinaryTree &tree) {
-    if (tree.Empty()) out << "_";
-    tree.LevelOrderTraversal(  //
-        tree.root_,            //
-        [&out](const Node *node, [[maybe_unused]] size_t level,
-               bool is_next_level) {
-          if (level != 0) {
-            if (is_next_level)
-              out << std::endl;
-            else
-              out << " ";
+  /* Снимок дерева в бинарном виде: заголовок (сигнатура, позиция в журнале
+   * команд, число узлов) и пары ключ-значение в pre-order. Pre-order BST
+   * однозначно задает форму дерева, поэтому после загрузки дерево совпадает
+   * с сохраненным, включая вывод print. Числа пишутся в порядке байт машины,
+   * строки - длина + байты.
+   *
+   * log_position - сколько строк журнала уже учтено в снимке, при
+   * восстановлении переигрывается только хвост журнала после нее.
+   * */
+  void WriteSnapshot(std::ostream &out, uint64_t log_position = 0) const {
+    uint64_t count = 0;
+    ForEachPreOrder([&count](const Node &) { ++count; });
+    WriteSnapshotHeader(out, log_position, count);
+    ForEachPreOrder([&out](const Node &node) {
+      WriteField(out, node.key);
+      WriteField(out, node.value);
+    });
+  }
+
+  /* Запись снимка в файл фоновым потоком.
+   * В вызывающем потоке делается только плоская копия пар в pre-order
+   * (O(n), без ввода-вывода), сериализация и запись идут в std::async, и
+   * дерево можно менять сразу после возврата. Результат - успех записи.
+   * */
+  [[nodiscard]] std::future<bool> SaveSnapshotAsync(
+      const std::string &path, uint64_t log_position = 0) const {
+    std::vector<std::pair<Key, Value>> records;
+    ForEachPreOrder([&records](const Node &node) {
+      records.emplace_back(node.key, node.value);
+    });
+    return std::async(
+        std::launch::async,
+        [path, log_position, records = std::move(records)]() {
+          std::ofstream out(path, std::ios::binary | std::ios::trunc);
+          WriteSnapshotHeader(out, log_position, records.size());
+          for (const auto &[key, value] : records) {
+            WriteField(out, key);
+            WriteField(out, value);
           }
-          if (node)
-            out << *node;
-          else
-            out << "_";
+          out.flush();
+          return static_cast<bool>(out);
         });
+  }
+
+  /* Загрузка снимка, старое содержимое удаляется.
+   * Дерево восстанавливается по pre-order стеком "открытых" правых ветвей:
+   * каждый узел кладется и снимается со стека не более одного раза.
+   * По времени: O(n). По памяти: O(n), узлы в одном непрерывном блоке.
+   *
+   * Возвращает позицию в журнале или std::nullopt, если снимок поврежден
+   * (тогда дерево остается пустым).
+   * */
+  std::optional<uint64_t> LoadSnapshot(std::istream &in) {
+    Clear();
+    char magic[sizeof(kSnapshotMagic)];
+    uint64_t log_position = 0;
+    uint64_t count = 0;
+    if (not in.read(magic, sizeof(magic)) or
+        not std::equal(std::begin(magic), std::end(magic),
+                       std::begin(kSnapshotMagic)) or
+        not ReadField(in, log_position) or not ReadField(in, count))
+      return std::nullopt;
+
+    // Pre-order check: each key is below the top of the stack of open
+    // left branches and above the last node whose right branch was entered
+    std::vector<Node> pool;
+    std::vector<size_t> parents;
+    std::vector<size_t> stack;
+    std::optional<Key> lower;
+    Key key{};
+    Value value{};
+    for (uint64_t i = 0; i < count; ++i) {
+      if (not ReadField(in, key) or not ReadField(in, value)) break;
+      std::optional<size_t> right_of;  // Last popped node
+      while (not stack.empty() and pool[stack.back()].key < key) {
+        right_of = stack.back();
+        lower = pool[stack.back()].key;
+        stack.pop_back();
+      }
+      if (not stack.empty() and not(key < pool[stack.back()].key)) break;
+      if (lower and not(*lower < key)) break;
+      // Right child of the last popped node, else left child of the top
+      if (right_of)
+        parents.push_back(*right_of);
+      else
+        parents.push_back(stack.empty() ? 0 : stack.back());
+      stack.push_back(pool.size());
+      pool.emplace_back(key, std::move(value), nullptr, true);
+    }
+    if (pool.size() != count) return std::nullopt;
+    for (size_t i = 1; i < pool.size(); ++i) {
+      Node *parent = &pool[parents[i]];
+      pool[i].parent = parent;
+      (pool[i].key < parent->key ? parent->left : parent->right) = &pool[i];
+    }
+    if (not pool.empty()) {
+      root_ = &pool.front();
+      pools_.push_back(std::move(pool));
+    }
+    return log_position;
+  }
+
+ public:
+  friend std::ostream &operator<<(std::ostream &out, const BinaryTree &tree) {
+    tree.PrintLevels(out);
     return out;
   }
 
+  /* Печать по уровням, тот же текст, что дает LevelOrderTraversal.
+   * На уровне хранятся только настоящие узлы (frontier), отсутствующие дети
+   * выводятся сериями "_" без помещения nullptr в очередь. Текст копится в
+   * буфере и пишется в поток крупными блоками.
+   *
+   * По времени: O(n). По памяти: O(w), w - максимальная ширина уровня.
+   * */
+  void PrintLevels(std::ostream &out) const {
+    if (Empty()) {
+      out << "_";
+      return;
+    }
+    static constexpr size_t kFlushSize = 1 << 16;
+    std::string buffer;
+    AppendNode(buffer, *root_);
+    std::vector<const Node *> frontier{root_};
+    std::vector<const Node *> next;
+    while (not frontier.empty()) {
+      buffer += '\n';
+      size_t nulls = 0;  // Pending run of "_"
+      bool is_first = true;
+      for (const Node *node : frontier) {
+        for (const Node *child : {node->left, node->right}) {
+          if (not child) {
+            ++nulls;
+            continue;
+          }
+          AppendNulls(buffer, nulls, is_first);
+          nulls = 0;
+          if (not is_first) buffer += ' ';
+          is_first = false;
+          AppendNode(buffer, *child);
+          next.push_back(child);
+        }
+        if (buffer.size() >= kFlushSize) {
+          out.write(buffer.data(), buffer.size());
+          buffer.clear();
+        }
+      }
+      AppendNulls(buffer, nulls, is_first);
+      frontier.swap(next);
+      next.clear();
+    }
+    out.write(buffer.data(), buffer.size());
+  }
+
+  /* Печать в формате задачи (как m2_taskB.py): каждый уровень целиком, 2^d
+   * позиций, на месте отсутствующих узлов "_". Последний выводимый уровень -
+   * тот, где ни у одного узла нет детей. Хранятся только настоящие узлы с
+   * номером позиции на уровне, пропуски между ними выводятся сериями.
+   *
+   * По времени: O(n + размер вывода). По памяти: O(w).
+   * */
+  void PrintFullLevels(std::ostream &out) const {
+    if (Empty()) {
+      out << "_";
+      return;
+    }
+    static constexpr size_t kFlushSize = 1 << 16;
+    std::string buffer;
+    std::vector<std::pair<const Node *, uint64_t>> frontier{{root_, 0}};
+    std::vector<std::pair<const Node *, uint64_t>> next;
+    uint64_t width = 1;
+    while (true) {
+      uint64_t position = 0;
+      bool is_first = true;
+      for (auto [node, index] : frontier) {
+        AppendNulls(buffer, index - position, is_first);
+        if (not is_first) buffer += ' ';
+        is_first = false;
+        AppendNode(buffer, *node);
+        position = index + 1;
+        if (node->left) next.emplace_back(node->left, 2 * index);
+        if (node->right) next.emplace_back(node->right, 2 * index + 1);
+        if (buffer.size() >= kFlushSize) {
+          out.write(buffer.data(), buffer.size());
+          buffer.clear();
+        }
+      }
+      AppendNulls(buffer, width - position, is_first);
+      if (next.empty()) break;
+      buffer += '\n';
+      frontier.swap(next);
+      next.clear();
+      width *= 2;
+    }
+    out.write(buffer.data(), buffer.size());
+  }
+
  private:
-  void SearchPlaceForKey(Key key, std::function<void(Node *)> left_callback,
-                         std::function<void(Node *)> right_callback,
-                         std::function<void(Node *)> equal_callback) const {
-    Node *current = root_;
-    while (current != nullptr) {
-      if (key < current->key) {
-        if (left_callback) left_callback(current);
-        current = current->left;
-      } else if (key > current->key) {
-        if (right_callback) right_callback(current);
-        current = current->right;
-      } else if (key == current->key) {
-        if (equal_callback) equal_callback(current);
-        break;  // TODO change if Key duplicate are possible
+  static void AppendNulls(std::string &buffer, size_t count, bool &is_first) {
+    for (size_t i = 0; i < count; ++i) {
+      if (not is_first) buffer += ' ';
+      is_first = false;
+      buffer += '_';
+    }
+  }
+
+  static void AppendNode(std::string &buffer, const Node &node) {
+    buffer += '[';
+    AppendValue(buffer, node.key);
+    buffer += ' ';
+    AppendValue(buffer, node.value);
+    if (node.parent) {
+      buffer += ' ';
+      AppendValue(buffer, node.parent->key);
+    }
+    buffer += ']';
+  }
+
+  template <class T>
+  static void AppendValue(std::string &buffer, const T &value) {
+    if constexpr (std::is_integral_v<T> and not std::is_same_v<T, bool> and
+                  not std::is_same_v<T, char>) {
+      char digits[24];
+      auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+      buffer.append(digits, result.ptr);
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      buffer += std::string_view(value);
+    } else {
+      std::ostringstream stream;
+      stream << value;
+      buffer += stream.str();
+    }
+  }
+
+  static constexpr char kSnapshotMagic[4] = {'B', 'T', 'S', '1'};
+
+  template <class Callback>
+  void ForEachPreOrder(Callback callback) const {
+    std::stack<const Node *> stack;
+    if (root_) stack.push(root_);
+    while (not stack.empty()) {
+      const Node *node = stack.top();
+      stack.pop();
+      callback(*node);
+      if (node->right) stack.push(node->right);
+      if (node->left) stack.push(node->left);
+    }
+  }
+
+  static void WriteSnapshotHeader(std::ostream &out, uint64_t log_position,
+                                  uint64_t count) {
+    out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+    WriteField(out, log_position);
+    WriteField(out, count);
+  }
+
+  template <class T>
+  static void WriteField(std::ostream &out, const T &field) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      out.write(reinterpret_cast<const char *>(&field), sizeof(field));
+    } else {
+      std::string_view str(field);
+      uint64_t size = str.size();
+      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      out.write(str.data(), static_cast<std::streamsize>(size));
+    }
+  }
+
+  template <class T>
+  static bool ReadField(std::istream &in, T &field) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      return static_cast<bool>(
+          in.read(reinterpret_cast<char *>(&field), sizeof(field)));
+    } else {
+      uint64_t size = 0;
+      if (not in.read(reinterpret_cast<char *>(&size), sizeof(size)))
+        return false;
+      // The size comes from the file, so the string grows by chunks as the
+      // data arrives: a forged one ends with the stream, not in bad_alloc
+      constexpr uint64_t kChunk = 1 << 16;
+      std::string str;
+      while (str.size() < size) {
+        const size_t read = str.size();
+        const size_t chunk = std::min<uint64_t>(kChunk, size - read);
+        str.resize(read + chunk);
+        if (not in.read(str.data() + read, static_cast<std::streamsize>(chunk)))
+          return false;
       }
+      field = T(std::string_view(str));
+      return true;
+    }
+  }
+
+  // Ссылка, в которой лежит узел ключа или куда его надо вставить
+  Node **FindSlot(Key key, Node *&parent) {
+    parent = nullptr;
+    Node **slot = &root_;
+    while (*slot and key != (*slot)->key) {
+      parent = *slot;
+      slot = key < parent->key ? &parent->left : &parent->right;
+    }
+    return slot;
+  }
+
+  Node *FindNode(Key key) const {
+    Node *current = root_;
+    while (current and key != current->key)
+      current = key < current->key ? current->left : current->right;
+    return current;
+  }
+
+  // Поиск для изменяющих операций: последний посещенный узел (найденный или
+  // тот, под которым ключа не оказалось) передается в OnAccess
+  Node *AccessNode(Key key) {
+    Node *last = nullptr;
+    Node *current = root_;
+    while (current and key != current->key) {
+      last = current;
+      current = key < current->key ? current->left : current->right;
     }
-  }  // TODO mb make returned Value more rich, mb rename
+    if (current) last = current;
+    if (last) OnAccess(last);
+    return current;
+  }
+
+ protected:
+  virtual void RemoveNode(Node *current) {
+    if (current->left and current->right) {  // if node haven both children
+      // Swap current with max in left subtree
+      Node *maxNode = Node::Max(current->left);
+      std::swap(maxNode->key, current->key);
+      std::swap(maxNode->value, current->value);
+      // MaxNode in the left subtree can have a child (only left)
+      if (maxNode->left) maxNode->left->parent = maxNode->parent;
+      ReplaceInParent(maxNode, maxNode->left);
+      FreeNode(maxNode);
+
+    } else if (current->left) {
+      current->left->parent = current->parent;
+      ReplaceInParent(current, current->left);
+      FreeNode(current);
+
+    } else if (current->right) {
+      current->right->parent = current->parent;
+      ReplaceInParent(current, current->right);
+      FreeNode(current);
+
+    } else {  // if node haven't children
+      ReplaceInParent(current, nullptr);
+      FreeNode(current);
+    }
+  }
+
+  void ReplaceInParent(Node *node, Node *child) {
+    if (node->parent)
+      node->parent->*node->PositionInParent() = child;
+    else
+      root_ = child;
+  }
+
+  // Pooled nodes are released together with their pool
+  static void FreeNode(Node *node) {
+    node->Clear();
+    if (node->pooled)
+      node->value = Value();
+    else
+      delete node;
+  }
 
  private:
+  static Node *LinkSorted(std::vector<Node> &nodes, size_t begin, size_t end,
+                          Node *parent) {
+    if (begin == end) return nullptr;
+    size_t mid = begin + (end - begin) / 2;
+    Node *node = &nodes[mid];
+    node->parent = parent;
+    node->left = LinkSorted(nodes, begin, mid, node);
+    node->right = LinkSorted(nodes, mid + 1, end, node);
+    return node;
+  }
+
+  // Right rotations until no node has a left child, returns node count
+  size_t TreeToVine() {
+    size_t size = 0;
+    Node **slot = &root_;
+    while (*slot) {
+      Node *node = *slot;
+      if (node->left) {
+        Node *left = node->left;
+        node->left = left->right;
+        left->right = node;
+        *slot = left;
+      } else {
+        ++size;
+        slot = &node->right;
+      }
+    }
+    return size;
+  }
+
+  // Left rotation of every second node along the right spine
+  void Compress(size_t count) {
+    Node **slot = &root_;
+    for (size_t i = 0; i < count; ++i) {
+      Node *child = *slot;
+      Node *grandchild = child->right;
+      child->right = grandchild->left;
+      grandchild->left = child;
+      *slot = grandchild;
+      slot = &grandchild->right;
+    }
+  }
+
+  void FixParents() {
+    if (not root_) return;
+    root_->parent = nullptr;
+    std::stack<Node *> stack;
+    stack.push(root_);
+    while (not stack.empty()) {
+      Node *node = stack.top();
+      stack.pop();
+      for (Node *child : {node->left, node->right}) {
+        if (not child) continue;
+        child->parent = node;
+        stack.push(child);
+      }
+    }
+  }
+
+ protected:
+  // Hook for self-adjusting trees, called by non-const Add/Set/Delete/Find
+  virtual void OnAccess([[maybe_unused]] Node *node) {}
+
   Node *root_;
+
+ private:
+  std::vector<std::vector<Node>> pools_;  // Contiguous blocks for bulk builds
+};
+
+/* Splay-дерево: каждый узел, к которому обращались (или под которым не нашли
+ * ключ), поднимается в корень поворотами zig / zig-zig / zig-zag. Часто
+ * запрашиваемые ключи оказываются у корня, и повторный доступ к небольшому
+ * "горячему" набору стоит O(log h), h - размер набора, а не O(глубина).
+ *
+ * Амортизированно O(log n) на операцию. Константные методы (Search, const
+ * Find/FindMin/FindMax, Min/Max, печать) дерево не меняют.
+ * */
+template <class Key, class Value>
+class SplayTree : public BinaryTree<Key, Value> {
+  using Node = typename BinaryTree<Key, Value>::Node;
+
+ protected:
+  void OnAccess(Node *node) override { Splay(node); }
+
+  // Как в m2_taskB.py: узел поднимается в корень, затем максимум его левого
+  // поддерева поднимается Splay над ним (узел становится правым сыном без
+  // левого поддерева) и забирает себе правое поддерево узла
+  void RemoveNode(Node *node) override {
+    Splay(node);
+    if (node->left and node->right) {
+      Node *max = Node::Max(node->left);
+      Splay(max);
+      max->right = node->right;
+      node->right->parent = max;
+    } else {
+      Node *child = node->left ? node->left : node->right;
+      if (child) child->parent = nullptr;
+      this->root_ = child;
+    }
+    BinaryTree<Key, Value>::FreeNode(node);
+  }
+
+ private:
+  void Splay(Node *x) {
+    while (x->parent) {
+      Node *p = x->parent;
+      Node *g = p->parent;
+      if (g) {
+        if ((g->left == p) == (p->left == x))
+          RotateUp(p);  // zig-zig
+        else
+          RotateUp(x);  // zig-zag
+      }
+      RotateUp(x);
+    }
+  }
+
+  // Поворот ребра (x, x->parent), x встает на место родителя
+  void RotateUp(Node *x) {
+    Node *p = x->parent;
+    Node *g = p->parent;
+    if (p->left == x) {
+      p->left = x->right;
+      if (x->right) x->right->parent = p;
+      x->right = p;
+    } else {
+      p->right = x->left;
+      if (x->left) x->left->parent = p;
+      x->left = p;
+    }
+    p->parent = x;
+    x->parent = g;
+    if (not g)
+      this->root_ = x;
+    else if (g->left == p)
+      g->left = x;
+    else
+      g->right = x;
+  }
+};
+
+/* Строка, хранящая до Capacity символов внутри объекта, длиннее - в куче.
+ * Для значений дерева: короткие значения копируются без выделения памяти
+ * (у std::string встроенный буфер обычно 15 символов).
+ * */
+template <size_t Capacity>
+class SmallString {
+ public:
+  SmallString() = default;
+  SmallString(std::string_view str) { Assign(str); }  // NOLINT
+  SmallString(const std::string &str) : SmallString(std::string_view(str)) {}
+  SmallString(const char *str) : SmallString(std::string_view(str)) {}
+  SmallString(const SmallString &other) { Assign(other); }
+  SmallString(SmallString &&other) noexcept { Steal(other); }
+  ~SmallString() = default;
+
+  SmallString &operator=(const SmallString &other) {
+    if (this != &other) Assign(other);
+    return *this;
+  }
+  SmallString &operator=(SmallString &&other) noexcept {
+    if (this != &other) Steal(other);
+    return *this;
+  }
+
+  operator std::string_view() const { return {data(), size_}; }  // NOLINT
+
+  [[nodiscard]] const char *data() const {
+    return heap_ ? heap_.get() : inline_;
+  }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] bool IsInline() const { return not heap_; }
+
+  friend bool operator==(const SmallString &a, const SmallString &b) {
+    return std::string_view(a) == std::string_view(b);
+  }
+  friend bool operator!=(const SmallString &a, const SmallString &b) {
+    return not(a == b);
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const SmallString &str) {
+    return out << std::string_view(str);
+  }
+
+ private:
+  void Assign(std::string_view str) {
+    if (str.size() <= Capacity) {
+      heap_.reset();
+      std::copy(str.begin(), str.end(), inline_);
+    } else {
+      heap_ = std::make_unique<char[]>(str.size());
+      std::copy(str.begin(), str.end(), heap_.get());
+    }
+    size_ = str.size();
+  }
+
+  void Steal(SmallString &other) {
+    heap_ = std::move(other.heap_);
+    if (not heap_)
+      std::copy(other.inline_, other.inline_ + other.size_, inline_);
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+
+  char inline_[Capacity] = {};
+  size_t size_ = 0;
+  std::unique_ptr<char[]> heap_;
 };
 
 enum class Commands {
@@ -257,36 +911,40 @@ enum class Commands {
 };
 
 struct KeyValuePair {
-  KeyValuePair(int key, std::string val) : Key(key), Value(std::move(val)) {}
+  KeyValuePair(int64_t key, std::string val)
+      : Key(key), Value(std::move(val)) {}
 
-  int Key;
+  int64_t Key;
   std::string Value;
 };
 
-std::pair<Commands, KeyValuePair> ParseCommand(const std::string &str) {
-  static const auto add_pattern = std::regex(R"(add ([+]?\d+) ([^ ]+)$)");
-  static const auto set_pattern =
-      std::regex(R"(set ([+]?\d+) ([^ ]+)$)");
-  static const auto delete_pattern =
-      std::regex(R"(delete ([+]?\d+)$)");
-  static const auto search_pattern =
-      std::regex(R"(search ([+]?\d+) ([^ ]+)$)");
+// Формат строк как в m2_taskB.py: ключ - знаковое 64-битное число, значение -
+// строка без пробелов (может быть пустой). Строка без перевода строки в конце
+// файла (terminated == false) допустима только для print.
+std::pair<Commands, KeyValuePair> ParseCommand(const std::string &str,
+                                               bool terminated = true) {
+  static const auto add_pattern = std::regex(R"(add\s([+-]?\d+)\s([^ ]*))");
+  static const auto set_pattern = std::regex(R"(set\s([+-]?\d+)\s([^ ]*))");
+  static const auto delete_pattern = std::regex(R"(delete\s([+-]?\d+))");
+  static const auto search_pattern = std::regex(R"(search\s([+-]?\d+))");
+  if (not terminated and str != "print")
+    return std::make_pair(Commands::Error, KeyValuePair(0, ""));
   try {
     std::smatch matches;
     if (std::regex_match(str, matches, add_pattern)) {
-      int key = std::stoi(matches[1]);
+      int64_t key = std::stoll(matches[1]);
       return std::make_pair(Commands::Add, KeyValuePair(key, matches[2]));
 
     } else if (std::regex_match(str, matches, set_pattern)) {
-      int key = std::stoi(matches[1]);
+      int64_t key = std::stoll(matches[1]);
       return std::make_pair(Commands::Set, KeyValuePair(key, matches[2]));
 
     } else if (std::regex_match(str, matches, delete_pattern)) {
-      int key = std::stoi(matches[1]);
+      int64_t key = std::stoll(matches[1]);
       return std::make_pair(Commands::Delete, KeyValuePair(key, ""));
 
     } else if (std::regex_match(str, matches, search_pattern)) {
-      int key = std::stoi(matches[1]);
+      int64_t key = std::stoll(matches[1]);
       return std::make_pair(Commands::Search, KeyValuePair(key, ""));
 
     } else if (str == "min") {
@@ -303,43 +961,74 @@ std::pair<Commands, KeyValuePair> ParseCommand(const std::string &str) {
   return std::make_pair(Commands::Error, KeyValuePair(0, ""));
 }
 
-void InteractWithBinTreeByTextCommands(std::istream &in, std::ostream &out) {
-  BinaryTree<int, std::string> tree{};
-
+// Tree - BinaryTree<int64_t, std::string> или SplayTree<int64_t, std::string>.
+// Ответы как в m2_taskB.py: error на add существующего ключа, на set и delete
+// отсутствующего, search - "1 значение" или "0", print - PrintFullLevels.
+// Возвращает число прочитанных строк - позицию в журнале для WriteSnapshot
+template <class Tree>
+uint64_t ExecuteBinTreeTextCommands(Tree &tree, std::istream &in,
+                                    std::ostream &out) {
+  uint64_t lines = 0;
   std::string line;
   while (std::getline(in, line)) {
+    ++lines;
     if (line.empty()) continue;
     //  while (in >> line) {
     //    if (line == "\n") continue;
-    std::pair<Commands, KeyValuePair> cmd_and_args = ParseCommand(line);
+    std::pair<Commands, KeyValuePair> cmd_and_args =
+        ParseCommand(line, not in.eof());
 
     switch (cmd_and_args.first) {
       case Commands::Add:
-        tree.Add(cmd_and_args.second.Key, cmd_and_args.second.Value);
+        if (not tree.TryEmplace(cmd_and_args.second.Key,
+                                std::move(cmd_and_args.second.Value)))
+          out << "error" << std::endl;
         break;
 
-      case Commands::Set:
-        tree.Set(cmd_and_args.second.Key, cmd_and_args.second.Value);
+      case Commands::Set: {
+        std::string *value = tree.Find(cmd_and_args.second.Key);
+        if (value)
+          *value = std::move(cmd_and_args.second.Value);
+        else
+          out << "error" << std::endl;
         break;
+      }
 
       case Commands::Delete:
-        tree.Delete(cmd_and_args.second.Key);
+        if (not tree.Extract(cmd_and_args.second.Key))
+          out << "error" << std::endl;
         break;
 
-      case Commands::Search:
-        out << tree.Search(cmd_and_args.second.Key) << std::endl;
+      case Commands::Search: {
+        const std::string *value = tree.Find(cmd_and_args.second.Key);
+        if (value)
+          out << "1 " << *value << std::endl;
+        else
+          out << "0" << std::endl;
         break;
+      }
 
-      case Commands::Min:
-        out << tree.Min().first << std::endl;
+      case Commands::Min: {
+        auto min = tree.FindMin();
+        if (min)
+          out << min->first << " " << min->second << std::endl;
+        else
+          out << "error" << std::endl;
         break;
+      }
 
-      case Commands::Max:
-        out << tree.Max().first << std::endl;
+      case Commands::Max: {
+        auto max = tree.FindMax();
+        if (max)
+          out << max->first << " " << max->second << std::endl;
+        else
+          out << "error" << std::endl;
         break;
+      }
 
       case Commands::Print:
-        out << tree << std::endl;
+        tree.PrintFullLevels(out);
+        out << std::endl;
         break;
 
       case Commands::Error:
@@ -347,4 +1036,27 @@ void InteractWithBinTreeByTextCommands(std::istream &in, std::ostream &out) {
         break;
     }
   }
+  return lines;
+}
+
+template <class Tree = SplayTree<int64_t, std::string>>
+void InteractWithBinTreeByTextCommands(std::istream &in, std::ostream &out) {
+  Tree tree{};
+  ExecuteBinTreeTextCommands(tree, in, out);
+}
+
+// Восстановление после сбоя: загрузка снимка и переигрывание только тех строк
+// журнала, которые идут после сохраненной в снимке позиции. Возвращает
+// позицию в журнале, до которой дерево восстановлено (ее и надо передать в
+// следующий WriteSnapshot), или std::nullopt, если снимок поврежден или
+// журнал короче позиции снимка
+template <class Tree>
+std::optional<uint64_t> RestoreBinTree(Tree &tree, std::istream &snapshot,
+                                       std::istream &log, std::ostream &out) {
+  std::optional<uint64_t> log_position = tree.LoadSnapshot(snapshot);
+  if (not log_position) return std::nullopt;
+  std::string line;
+  for (uint64_t i = 0; i < *log_position; ++i)
+    if (not std::getline(log, line)) return std::nullopt;
+  return *log_position + ExecuteBinTreeTextCommands(tree, log, out);
 }
@@ -0,0 +1,67 @@
+// Copyright 2021 Fedor Teleshov <fdrt29@gmail.com>
+
+/* Сравнение BinaryTree и SplayTree на перекошенном потоке Find.
+ * Оба дерева строятся BuildFromSorted из 2^depth ключей (сбалансированы) и
+ * получают одну и ту же последовательность запросов: доля hot_share из них
+ * приходится на hot случайных "горячих" ключей, остальные - равномерно по
+ * всем. Генератор с фиксированным зерном, так что трасса воспроизводима.
+ *
+ * Запуск: splay_bench [depth] [calls]
+ * Сборка: g++ -std=c++17 -O2 -pthread splay_bench.cpp -o splay_bench
+ * */
+
+#include <chrono>
+#include <random>
+
+#include "m2_taskB.hpp"
+
+std::vector<int> MakeTrace(int size, size_t calls, int hot, double hot_share) {
+  std::mt19937_64 random(2021);
+  std::uniform_int_distribution<int> any_key(0, size - 1);
+  std::vector<int> hot_keys(hot);
+  for (int &key : hot_keys) key = any_key(random);
+  std::uniform_int_distribution<int> any_hot(0, hot - 1);
+  std::bernoulli_distribution is_hot(hot_share);
+  std::vector<int> trace(calls);
+  for (int &key : trace)
+    key = is_hot(random) ? hot_keys[any_hot(random)] : any_key(random);
+  return trace;
+}
+
+template <class Tree>
+double MeasureFind(int size, const std::vector<int> &trace, size_t &found) {
+  std::vector<std::pair<int, std::string>> items;
+  items.reserve(size);
+  for (int key = 0; key < size; ++key) items.emplace_back(key, "v");
+  Tree tree;
+  tree.BuildFromSorted(items);
+  auto start = std::chrono::steady_clock::now();
+  for (int key : trace) found += tree.Find(key) != nullptr;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  int depth = argc > 1 ? std::stoi(argv[1]) : 20;
+  size_t calls = argc > 2 ? std::stoull(argv[2]) : 4000000;
+  int size = 1 << depth;
+  for (auto [hot, hot_share] : {std::pair{16, 0.99}, std::pair{64, 0.95},
+                                std::pair{1024, 0.9}, std::pair{size, 1.0}}) {
+    std::vector<int> trace = MakeTrace(size, calls, hot, hot_share);
+    size_t found = 0;
+    double plain = MeasureFind<BinaryTree<int, std::string>>(size, trace, found);
+    double splay = MeasureFind<SplayTree<int, std::string>>(size, trace, found);
+    if (found != 2 * calls) {
+      std::cout << "lost keys\n";
+      return 1;
+    }
+    std::cout << size << " keys, " << calls << " Find, ";
+    if (hot == size)
+      std::cout << "uniform";
+    else
+      std::cout << hot_share * 100 << "% on " << hot << " hot keys";
+    std::cout << ": plain " << plain << " s, splay " << splay << " s\n";
+  }
+  return 0;
+}
@@ -37,12 +37,12 @@ class MinHeap {  //  родитель всегда был меньше
         i_min = LeftI(index);
     }
   }
-  bool Add(key_type key, const val_type &val) {
+  bool Add(key_type key, val_type val) {
     auto elm = key_to_index.find(key);
     if (elm != key_to_index.end()) return false;
     size_t size = heap.size();
     key_to_index[key] = size;
-    heap.emplace_back(key, val);
+    heap.emplace_back(key, std::move(val));
     ShiftUp(size);
     return true;
   }
@@ -59,10 +59,12 @@ class MinHeap {  //  родитель всегда был меньше
     }
     return true;
   }
-  std::optional<std::tuple<size_t, val_type>> Search(key_type key) {
+  // Значения возвращаются по ссылке, действительной до изменения кучи
+  std::optional<std::tuple<size_t, const val_type &>> Search(key_type key) {
     auto node_itr = SearchNode(key);
     if (node_itr == heap.end()) return std::nullopt;
-    return std::make_tuple(node_itr - heap.begin(), node_itr->val);
+    return std::tuple<size_t, const val_type &>(node_itr - heap.begin(),
+                                                node_itr->val);
   }
   bool Set(key_type key, val_type val) {
     auto node_itr = SearchNode(key);
@@ -70,26 +72,27 @@ class MinHeap {  //  родитель всегда был меньше
     node_itr->val = std::move(val);
     return true;
   }
-  std::optional<std::tuple<key_type, size_t, val_type>> Min() {
+  std::optional<std::tuple<key_type, size_t, const val_type &>> Min() {
     if (Empty()) return std::nullopt;
-    return std::make_tuple(heap[0].key, 0, heap[0].val);
+    return std::tuple<key_type, size_t, const val_type &>(heap[0].key, 0,
+                                                          heap[0].val);
   }
-  std::optional<std::tuple<key_type, size_t, val_type>> Max() {
+  std::optional<std::tuple<key_type, size_t, const val_type &>> Max() {
     if (Empty()) return std::nullopt;
     auto node_itr = std::max_element(
         heap.begin(), heap.end(),
         [](const Node &a, const Node &b) { return (a.key < b.key); });
-    return std::make_tuple(node_itr->key, key_to_index[node_itr->key],
-                           node_itr->val);
+    return std::tuple<key_type, size_t, const val_type &>(
+        node_itr->key, key_to_index[node_itr->key], node_itr->val);
   }
   std::optional<std::tuple<key_type, val_type>> Extract() {
     if (Empty()) return std::nullopt;
     Swap(0, heap.size() - 1);
-    Node res = heap.back();
+    Node res = std::move(heap.back());
     heap.pop_back();
     key_to_index.erase(res.key);
     ShiftDown(0);
-    return std::make_tuple(res.key, res.val);
+    return std::make_tuple(res.key, std::move(res.val));
   }
 
   [[nodiscard]] bool Empty() const { return heap.empty(); }
@@ -234,11 +237,11 @@ void InteractWithDSByTextCommands(std::istream &in, std::ostream &out) {
 
     switch (cmd) {
       case Commands::Add:
-        if (not min_heap.Add(args.Key, args.Value)) error(out);
+        if (not min_heap.Add(args.Key, std::move(args.Value))) error(out);
         break;
 
       case Commands::Set:
-        if (not min_heap.Set(args.Key, args.Value)) error(out);
+        if (not min_heap.Set(args.Key, std::move(args.Value))) error(out);
         break;
 
       case Commands::Delete:
@@ -1,18 +1,34 @@
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <regex>
 #include <tuple>
 #include <vector>
 
+using uint128 = unsigned __int128;
+
 struct Item {
-  Item(int weight, int cost) : weight(weight), cost(cost) {}
-  int weight;
-  int cost;
+  Item(uint64_t weight, uint64_t cost) : weight(weight), cost(cost) {}
+  uint64_t weight;
+  uint64_t cost;
 };
 
-// TODO rework
-std::vector<uint64_t> normWeights(size_t size, const std::vector<Item> &items) {
-  uint64_t g = gcd(size, items[0].weight);
+uint64_t gcd(uint64_t a, uint64_t b) {
+  while (a && b) {
+    if (a >= b) {
+      a %= b;
+    } else {
+      b %= a;
+    }
+  }
+  return a | b;
+}
+
+// Делит веса и вместимость на общий НОД, limit меняется на месте
+std::vector<uint64_t> normWeights(size_t &limit,
+                                  const std::vector<Item> &items) {
+  uint64_t g = gcd(limit, items[0].weight);
   for (uint64_t i = 1; i < items.size(); ++i) {
     g = gcd(g, items[i].weight);
   }
@@ -23,20 +39,18 @@ std::vector<uint64_t> normWeights(size_t size, const std::vector<Item> &items) {
   for (uint64_t i = 0; i < items.size(); ++i) {
     norm_weights[i] = items[i].weight / g;
   }
-  norm_size_ /= g;
+  limit /= g;
   return norm_weights;
 }
 
-uint64_t Backpack::gcd(uint64_t a, uint64_t b) {
-  while (a && b) {
-    if (a >= b) {
-      a %= b;
-    } else {
-      b %= a;
-    }
-  }
-  return a | b;
-}
+// Больше - вместо таблицы memo строки DP и восстановление по Хиршбергу
+const size_t kMemoLimitBytes = 256 << 20;
+// Больше ячеек n * (limit + 1) - сначала ветви и границы с бюджетом вершин
+const uint64_t kMaxDpCells = 1ULL << 33;
+// Вершин перебора на столько ячеек DP, которые он заменяет
+const uint64_t kCellsPerNode = 256;
+// Не больше полезных предметов - встреча посередине, если она дешевле DP
+const size_t kMeetInMiddleMaxItems = 40;
 
 // 165
 // 23 92
@@ -51,40 +65,265 @@ uint64_t Backpack::gcd(uint64_t a, uint64_t b) {
 // 82 72
 // end
 
-// mb change int to something bigger?
-std::tuple<int, int, std::vector<size_t>> alg(const std::vector<Item> &items,
-                                              int limit) {
-  std::vector<std::vector<int>> memo(items.size() + 1,
-                                     std::vector<int>(limit + 1, 0));
-
-  std::vector<uint64_t> norm_weights = normWeights(items);
-  for (size_t i = 1; i <= items.size(); i++) {
-    for (size_t j = 1; j <= limit; j++) {  // local limit
-      if (items[i - 1].weight <= j) {
-        memo[i][j] =
-            std::max(memo[i - 1][j],
-                     items[i - 1].cost + memo[i - 1][j - items[i - 1].weight]);
-      } else {
-        memo[i][j] = memo[i - 1][j];
+// 0/1 DP по предметам [begin, end) в одной строке: row[j] - лучшая стоимость
+// при весе <= j
+void fillRow(const std::vector<Item> &items,
+             const std::vector<uint64_t> &weights, size_t begin, size_t end,
+             std::vector<uint64_t> &row) {
+  size_t limit = row.size() - 1;
+  for (size_t i = begin; i < end; i++) {
+    if (weights[i] > limit) continue;
+    for (size_t j = limit + 1; j-- > weights[i];) {
+      row[j] = std::max(row[j], row[j - weights[i]] + items[i].cost);
+    }
+  }
+}
+
+// Делим предметы пополам, ищем разбиение вместимости с максимальной суммой
+// строк половин и решаем половины отдельно. Память O(limit), время O(n*limit)
+void hirschberg(const std::vector<Item> &items,
+                const std::vector<uint64_t> &weights, size_t begin, size_t end,
+                size_t limit, std::vector<size_t> &res_ind) {
+  if (end - begin == 1) {
+    if (weights[begin] <= limit and items[begin].cost > 0)
+      res_ind.push_back(begin + 1);
+    return;
+  }
+  size_t mid = begin + (end - begin) / 2;
+  size_t left_limit = 0;
+  {
+    std::vector<uint64_t> left(limit + 1, 0);
+    std::vector<uint64_t> right(limit + 1, 0);
+    fillRow(items, weights, begin, mid, left);
+    fillRow(items, weights, mid, end, right);
+    uint64_t best = 0;
+    for (size_t c = 0; c <= limit; c++) {
+      if (left[c] + right[limit - c] > best) {
+        best = left[c] + right[limit - c];
+        left_limit = c;
       }
     }
   }
+  hirschberg(items, weights, begin, mid, left_limit, res_ind);
+  hirschberg(items, weights, mid, end, limit - left_limit, res_ind);
+}
 
-  //Обратный ход
+/* Ветви и границы для вместимости, при которой DP не по силам. Предметы
+ * сортируются по убыванию cost / weight, перебор сначала кладет предмет,
+ * потом пропускает. Оценка ветви - решение непрерывной задачи (Данциг):
+ * целые предметы жадно, затем дробная часть критического, который ищется
+ * бинарным поиском по префиксным суммам весов. Ветка отбрасывается, если
+ * оценка не больше лучшего найденного.
+ * Память O(n), от limit не зависит, время в худшем случае экспоненциально
+ * (стоимости, скоррелированные с весами), поэтому не больше max_nodes вершин:
+ * не хватило - res_ind не трогается и возвращается false.
+ */
+bool branchAndBound(const std::vector<Item> &items,
+                    const std::vector<uint64_t> &weights, size_t limit,
+                    uint64_t max_nodes, std::vector<size_t> &res_ind) {
+  std::vector<size_t> order;
+  for (size_t i = 0; i < items.size(); i++) {
+    if (weights[i] <= limit and items[i].cost > 0) order.push_back(i);
+  }
+  // a before b if cost_a / weight_a > cost_b / weight_b, zero weights first
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return static_cast<uint128>(items[a].cost) * weights[b] >
+           static_cast<uint128>(items[b].cost) * weights[a];
+  });
+  const size_t m = order.size();
+  std::vector<uint128> prefix_weight(m + 1, 0);
+  std::vector<uint128> prefix_cost(m + 1, 0);
+  for (size_t k = 0; k < m; k++) {
+    prefix_weight[k + 1] = prefix_weight[k] + weights[order[k]];
+    prefix_cost[k + 1] = prefix_cost[k] + items[order[k]].cost;
+  }
+  auto bound = [&](size_t k, size_t capacity, uint128 cost) {
+    uint128 edge = prefix_weight[k] + capacity;
+    size_t r = std::upper_bound(prefix_weight.begin() + k, prefix_weight.end(),
+                                edge) -
+               prefix_weight.begin() - 1;
+    uint128 result = cost + prefix_cost[r] - prefix_cost[k];
+    if (r < m) {
+      result += (edge - prefix_weight[r]) * items[order[r]].cost /
+                weights[order[r]];
+    }
+    return result;
+  };
+
+  std::vector<char> take(m, 0);
+  std::vector<char> best_take(m, 0);
+  uint128 best_cost = 0;
+  size_t capacity = limit;
+  uint128 cost = 0;
+  size_t k = 0;
+  for (uint64_t nodes = 0;; nodes++) {
+    if (nodes == max_nodes) return false;
+    if (k < m and bound(k, capacity, cost) > best_cost) {
+      take[k] = weights[order[k]] <= capacity;
+      if (take[k]) {
+        capacity -= weights[order[k]];
+        cost += items[order[k]].cost;
+      }
+      k++;
+      continue;
+    }
+    if (k == m and cost > best_cost) {
+      best_cost = cost;
+      best_take = take;
+    }
+    // Back to the last item that was put in and try without it
+    while (k > 0 and not take[k - 1]) k--;
+    if (k == 0) break;
+    k--;
+    take[k] = 0;
+    capacity += weights[order[k]];
+    cost -= items[order[k]].cost;
+    k++;
+  }
+  for (size_t j = 0; j < m; j++) {
+    if (best_take[j]) res_ind.push_back(order[j] + 1);
+  }
+  return true;
+}
+
+struct HalfSum {
+  uint64_t weight;
+  uint64_t cost;
+  uint32_t mask;
+};
+
+// Все подмножества useful[first, first + count) с весом <= limit
+std::vector<HalfSum> enumerateHalf(const std::vector<Item> &items,
+                                   const std::vector<uint64_t> &weights,
+                                   const std::vector<size_t> &useful,
+                                   size_t first, size_t count, size_t limit) {
+  std::vector<HalfSum> sums{{0, 0, 0}};
+  sums.reserve(size_t(1) << count);
+  for (size_t k = 0; k < count; k++) {
+    const uint64_t weight = weights[useful[first + k]];
+    const uint64_t cost = items[useful[first + k]].cost;
+    for (size_t s = 0, size = sums.size(); s < size; s++) {
+      if (sums[s].weight <= limit - weight) {
+        sums.push_back({sums[s].weight + weight, sums[s].cost + cost,
+                        sums[s].mask | 1U << k});
+      }
+    }
+  }
+  return sums;
+}
+
+// Встреча посередине для n <= 40 при любом limit: подмножества половин,
+// у правой остается Парето-фронт (с весом растет стоимость), и для каждой
+// левой суммы двумя указателями находится самое тяжелое подходящее
+// дополнение. Время O(2^(n/2) * n), память O(2^(n/2))
+void meetInMiddle(const std::vector<Item> &items,
+                  const std::vector<uint64_t> &weights, size_t limit,
+                  std::vector<size_t> &res_ind) {
+  std::vector<size_t> useful;
+  for (size_t i = 0; i < items.size(); i++) {
+    if (weights[i] <= limit and items[i].cost > 0) useful.push_back(i);
+  }
+  const size_t half = useful.size() / 2;
+  std::vector<HalfSum> left =
+      enumerateHalf(items, weights, useful, 0, half, limit);
+  std::vector<HalfSum> right =
+      enumerateHalf(items, weights, useful, half, useful.size() - half, limit);
+
+  auto lighter = [](const HalfSum &a, const HalfSum &b) {
+    return a.weight < b.weight or (a.weight == b.weight and a.cost > b.cost);
+  };
+  std::sort(left.begin(), left.end(), lighter);
+  std::sort(right.begin(), right.end(), lighter);
+  size_t front = 0;
+  for (size_t s = 1; s < right.size(); s++) {
+    if (right[s].cost > right[front].cost) right[++front] = right[s];
+  }
+  right.resize(front + 1);
+
+  uint64_t best_cost = 0;
+  uint32_t best_left = 0;
+  uint32_t best_right = 0;
+  size_t r = right.size() - 1;
+  for (const HalfSum &sum : left) {
+    // The right end of the front only moves left while the left weight grows
+    while (right[r].weight > limit - sum.weight) r--;
+    if (sum.cost + right[r].cost > best_cost) {
+      best_cost = sum.cost + right[r].cost;
+      best_left = sum.mask;
+      best_right = right[r].mask;
+    }
+  }
+  for (size_t k = 0; k < useful.size(); k++) {
+    bool taken = k < half ? best_left >> k & 1 : best_right >> (k - half) & 1;
+    if (taken) res_ind.push_back(useful[k] + 1);
+  }
+}
+
+std::tuple<uint64_t, uint64_t, std::vector<size_t>> alg(
+    const std::vector<Item> &items, size_t limit) {
+  if (items.empty()) return std::make_tuple(0, 0, std::vector<size_t>());
+  std::vector<uint64_t> weights = normWeights(limit, items);
+  // Вместимость больше суммарного веса ответа не меняет, а строка DP
+  // размером с нее может не поместиться в память
+  size_t total_weight = 0;
+  for (size_t i = 0; i < items.size() and total_weight < limit; i++) {
+    if (weights[i] <= limit)
+      total_weight += std::min<size_t>(weights[i], limit - total_weight);
+  }
+  limit = std::min(limit, total_weight);
+
+  // Мало полезных предметов - 2^(m/2) полусумм дешевле n * (limit + 1)
+  // ячеек. Иначе таблица, пока помещается в память, строки - пока
+  // помещается строка; перебор без ограничения - только когда не помещается
+  // и строка, а при больше kMaxDpCells ячейках он идет первым с бюджетом
   std::vector<size_t> res_ind;
-  int res_weight = 0;
-  int res_cost = 0;
-  size_t j = limit;
-  size_t i = items.size();
-  while (i > 1 or j > 1) {
-    if (memo[i][j] == 0) break;
-    if (memo[i][j] != memo[i - 1][j]) {
-      res_ind.push_back(i);
-      res_weight += items[i - 1].weight;
-      res_cost += items[i - 1].cost;
-      j -= items[i - 1].weight;
+  const size_t max_row = kMemoLimitBytes / sizeof(uint64_t);
+  size_t useful = 0;
+  for (size_t i = 0; i < items.size(); i++) {
+    useful += weights[i] <= limit and items[i].cost > 0;
+  }
+  if (useful <= kMeetInMiddleMaxItems and
+      (size_t(1) << (useful + 1) / 2) * 64 / items.size() <= limit) {
+    meetInMiddle(items, weights, limit, res_ind);
+  } else if (limit >= max_row) {
+    branchAndBound(items, weights, limit,
+                   std::numeric_limits<uint64_t>::max(), res_ind);
+  } else if (limit >= max_row / (items.size() + 1)) {
+    const uint64_t budget = (limit + 1) / kCellsPerNode * items.size();
+    if (limit < kMaxDpCells / items.size() or
+        not branchAndBound(items, weights, limit, budget, res_ind))
+      hirschberg(items, weights, 0, items.size(), limit, res_ind);
+  } else {
+    std::vector<std::vector<uint64_t>> memo(
+        items.size() + 1, std::vector<uint64_t>(limit + 1, 0));
+    for (size_t i = 1; i <= items.size(); i++) {
+      for (size_t j = 0; j <= limit; j++) {  // local limit
+        if (weights[i - 1] <= j) {
+          memo[i][j] =
+              std::max(memo[i - 1][j],
+                       items[i - 1].cost + memo[i - 1][j - weights[i - 1]]);
+        } else {
+          memo[i][j] = memo[i - 1][j];
+        }
+      }
+    }
+
+    //Обратный ход
+    size_t j = limit;
+    for (size_t i = items.size(); i > 0; i--) {
+      if (memo[i][j] == 0) break;
+      if (memo[i][j] != memo[i - 1][j]) {
+        res_ind.push_back(i);
+        j -= weights[i - 1];
+      }
     }
-    i -= 1;
+  }
+
+  uint64_t res_weight = 0;
+  uint64_t res_cost = 0;
+  for (size_t i : res_ind) {
+    res_weight += items[i - 1].weight;
+    res_cost += items[i - 1].cost;
   }
   return std::make_tuple(res_weight, res_cost, res_ind);
 }
@@ -92,7 +331,7 @@ std::tuple<int, int, std::vector<size_t>> alg(const std::vector<Item> &items,
 inline void error() { std::cout << "error" << std::endl; }
 
 int main() {
-  int limit = 0;
+  int64_t limit = 0;
   std::vector<Item> items;
 
   // Handle input
@@ -107,7 +346,11 @@ int main() {
 
     if (not is_limit_initialized) {
       try {
-        limit = std::stoi(line);
+        limit = std::stoll(line);
+        if (limit < 0) {
+          error();
+          continue;
+        }
         is_limit_initialized = true;
       } catch (std::invalid_argument const &e) {
         error();
@@ -118,7 +361,11 @@ int main() {
     }
 
     if (std::regex_match(line, matches, item_pattern)) {
-      items.emplace_back(std::stoi(matches[1]), std::stoi(matches[2]));
+      try {
+        items.emplace_back(std::stoull(matches[1]), std::stoull(matches[2]));
+      } catch (std::out_of_range const &e) {
+        error();
+      }
       continue;
     }
     // Else
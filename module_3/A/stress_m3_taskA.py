@@ -0,0 +1,86 @@
+import itertools
+import random
+import subprocess
+import sys
+import time
+
+# Usage: python3 stress_m3_taskA.py ./m3_taskA [n]
+# Runs the solver on n random items for every branch of alg and checks the
+# answer; for n <= 20 the cost is also compared with a full search.
+
+MODES = {
+    # name: (capacity, max weight, costs, max n)
+    'table': (30, 100, 'random', None),
+    'hirschberg': (5000, 100000, 'random', None),
+    'capacity > sum': (10 ** 15, 100, 'random', None),
+    'meet in middle': (10 ** 12, 10 ** 12, 'random', 40),
+    'branch-bound': (10 ** 12, 10 ** 12, 'random', None),
+    # weights from max / 3, cost = weight + 1000: the search gives up, rows finish
+    'correlated': (10 ** 7, 30000, 'correlated', 1000),
+}
+
+FIXED = [
+    # (input, expected output)
+    ('1000000000000000\n1 1\n2 3\n5 4\nend\n', '8 8\n1\n2\n3\n'),
+    ('165\n23 92\n31 57\n29 49\n44 68\n53 60\n38 43\n63 67\n85 84\n89 87\n'
+     '82 72\nend\n', '165 309\n1\n2\n3\n4\n6\n'),
+]
+
+
+def best_cost(items, capacity):
+    best = 0
+    for mask in itertools.product((0, 1), repeat=len(items)):
+        chosen = [item for item, bit in zip(items, mask) if bit]
+        if sum(weight for weight, _ in chosen) <= capacity:
+            best = max(best, sum(cost for _, cost in chosen))
+    return best
+
+
+def make_item(rnd, max_weight, costs):
+    if costs == 'correlated':
+        weight = rnd.randint(max_weight // 3, max_weight)
+        return weight, weight + 1000
+    weight = rnd.randint(1, max_weight)
+    return weight, weight if costs == 'weight' else rnd.randint(0, max_weight)
+
+
+def run(binary, n, capacity, max_weight, costs):
+    rnd = random.Random(n)
+    items = [make_item(rnd, max_weight, costs) for _ in range(n)]
+    data = '%d\n%s\nend\n' % (capacity, '\n'.join('%d %d' % item for item in items))
+
+    start = time.time()
+    result = subprocess.run([binary], input=data, capture_output=True, text=True)
+    elapsed = time.time() - start
+    if result.returncode != 0:
+        return 'crashed with code %d' % result.returncode, elapsed
+
+    lines = result.stdout.split()
+    total_weight, total_cost = int(lines[0]), int(lines[1])
+    numbers = [int(number) for number in lines[2:]]
+    weight = sum(items[number - 1][0] for number in numbers)
+    cost = sum(items[number - 1][1] for number in numbers)
+    if weight != total_weight or cost != total_cost or weight > capacity:
+        return 'wrong answer', elapsed
+    if numbers != sorted(set(numbers)):
+        return 'numbers not sorted', elapsed
+    if n <= 20 and cost != best_cost(items, capacity):
+        return 'not optimal', elapsed
+    return 'ok', elapsed
+
+
+if __name__ == '__main__':
+    binary = sys.argv[1]
+    n = int(sys.argv[2]) if len(sys.argv) > 2 else 10 ** 5
+    failed = False
+    for data, expected in FIXED:
+        result = subprocess.run([binary], input=data, capture_output=True, text=True)
+        status = 'ok' if result.stdout == expected else 'got %r' % result.stdout
+        print('%-14s %s' % ('fixed', status))
+        failed = failed or status != 'ok'
+    for name, (capacity, max_weight, costs, max_n) in MODES.items():
+        size = min(n, max_n) if max_n else n
+        status, elapsed = run(binary, size, capacity, max_weight, costs)
+        print('%-14s n=%d %s %.2fs' % (name, size, status, elapsed))
+        failed = failed or status != 'ok'
+    sys.exit(1 if failed else 0)
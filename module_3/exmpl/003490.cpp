@@ -4,38 +4,63 @@
 #include <cctype>
 #include <limits>
 #include <algorithm>
+#include <charconv>
+#include <thread>
 
-size_t countZeroes(uint64_t number) {
-    size_t count = 0;
-    while ((number & 1) == 0) {
-        number >>= 1;
-        ++count;
-    }
-    return count;
-}
+const char kInc = 0;
+const char kDec = 1;
+const char kDbl = 2;
 
-std::vector<char> getSteps(uint64_t half_money) {
-    const char kInc = 0;
-    const char kDec = 1;
-    const char kDbl = 2;
+// step repeated count times in a row
+struct Run {
+    char step;
+    uint64_t count;
+};
 
-    std::vector<char> steps;
-    uint64_t money = half_money;
+// Every inc or dec is followed by a run of dbl, and the runs of dbl take at
+// most 65 bits together, so a plan has fewer runs than this
+const size_t kMaxRuns = 2 * 66;
+
+const unsigned kMaxThreads = 1024;
+
+/* Жадный выбор с конца: из нечетного money идем в то из money - 1 и
+ * money + 1, которое делится на 4 (то есть dec при money = 3 mod 4, кроме
+ * money = 3), четное делим пополам. Подряд идущие dbl снимаются одним ctz.
+ * money 128-битное, чтобы dec от 2^64 - 1 не переполнялся.
+ * По времени: O(log money). По памяти: O(1), план пишется сериями в runs в
+ * прямом порядке; возвращается число серий.
+ */
+size_t getRuns(uint64_t half_money, Run* runs) {
+    size_t size = 0;
+    unsigned __int128 money = half_money;
     while (money) {
         if ((money & 1) == 1) {
-            if (money > 3 && countZeroes(money + 1) > countZeroes(money - 1)) {
-                steps.push_back(kDec);
+            if (money > 3 && (money & 3) == 3) {
+                runs[size++] = {kDec, 1};
                 ++money;
             } else {
-                steps.push_back(kInc);
+                runs[size++] = {kInc, 1};
                 --money;
             }
         } else {
-            steps.push_back(kDbl);
-            money >>= 1;
+            // money <= 2^64, so zero low bits mean money = 2^64
+            uint64_t low = static_cast<uint64_t>(money);
+            uint64_t zeroes = low != 0 ? __builtin_ctzll(low) : 64;
+            runs[size++] = {kDbl, zeroes};
+            money >>= zeroes;
         }
     }
-    std::reverse(steps.begin(), steps.end());
+    std::reverse(runs, runs + size);
+    return size;
+}
+
+std::vector<char> getSteps(uint64_t half_money) {
+    Run runs[kMaxRuns];
+    size_t size = getRuns(half_money, runs);
+    std::vector<char> steps;
+    for (size_t i = 0; i < size; ++i) {
+        steps.insert(steps.end(), runs[i].count, runs[i].step);
+    }
     return steps;
 }
 
@@ -80,10 +105,118 @@ uint64_t getNumber() {
     return std::numeric_limits<uint64_t>::max();
 }
 
-int main() {
+// Number of steps, or with plan the runs like "inc dbl*3 dec dbl*2"
+void writeAnswer(uint64_t half_money, bool plan, std::string& out) {
+    static const char* const kNames[] = {"inc", "dec", "dbl"};
+    Run runs[kMaxRuns];
+    size_t size = getRuns(half_money, runs);
+    char digits[24];
+    if (!plan) {
+        uint64_t steps = 0;
+        for (size_t i = 0; i < size; ++i) {
+            steps += runs[i].count;
+        }
+        out.append(digits, std::to_chars(digits, digits + sizeof(digits), steps).ptr);
+        out += '\n';
+        return;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (i != 0) {
+            out += ' ';
+        }
+        out += kNames[static_cast<int>(runs[i].step)];
+        if (runs[i].count > 1) {
+            out += '*';
+            out.append(digits,
+                       std::to_chars(digits, digits + sizeof(digits), runs[i].count).ptr);
+        }
+    }
+    out += '\n';
+}
+
+/* Пакетный режим: по числу в строке, ответ на каждое в своей строке в том
+ * же порядке, на плохую строку - error, пустые пропускаются. Строки читаются
+ * блоками по kBlock, блок делится на threads непрерывных кусков, каждый
+ * поток пишет ответы своего куска в свой буфер, и буферы выводятся по
+ * порядку одним write.
+ * По времени: O(n log money / threads) на ответы, чтение и вывод в одном
+ * потоке. По памяти: O(kBlock).
+ */
+void solveBatch(unsigned threads, bool plan) {
+    const uint64_t kBlock = 1 << 18;
+    std::vector<uint64_t> numbers;
+    std::vector<char> valid;
+    std::vector<std::string> outputs(threads);
+    std::string line;
+    bool more = true;
+    while (more) {
+        numbers.clear();
+        valid.clear();
+        while (numbers.size() < kBlock) {
+            more = static_cast<bool>(std::getline(std::cin, line));
+            if (!more) {
+                break;
+            }
+            if (line.size() == 0) {
+                continue;
+            }
+            uint64_t number = 0;
+            valid.push_back(getOneUint64_t(line, number));
+            numbers.push_back(number);
+        }
+        auto work = [&](unsigned t) {
+            uint64_t first = numbers.size() * t / threads;
+            uint64_t last = numbers.size() * (t + 1) / threads;
+            outputs[t].clear();
+            for (uint64_t i = first; i < last; ++i) {
+                if (valid[i]) {
+                    writeAnswer(numbers[i], plan, outputs[t]);
+                } else {
+                    outputs[t] += "error\n";
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) {
+            pool.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+        for (const std::string& output : outputs) {
+            std::cout.write(output.data(), output.size());
+        }
+    }
+}
+
+// Thread count from the command line, 0 if it is not a number in [1, kMaxThreads]
+unsigned parseThreads(const std::string& arg) {
+    unsigned threads = 0;
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), threads);
+    if (error != std::errc() || end != arg.data() + arg.size() || threads > kMaxThreads) {
+        return 0;
+    }
+    return threads;
+}
+
+int main(int argc, char* argv[]) {
     std::ios_base::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
+    // "count [threads]" or "plan [threads]" - many numbers, see solveBatch
+    if (argc > 1 && (std::string(argv[1]) == "count" || std::string(argv[1]) == "plan")) {
+        unsigned threads = argc > 2 ? parseThreads(argv[2])
+                                    : std::max(1U, std::thread::hardware_concurrency());
+        if (threads == 0) {
+            std::cerr << "usage: " << argv[0] << " count|plan [threads], threads from 1 to "
+                      << kMaxThreads << "\n";
+            return 1;
+        }
+        solveBatch(threads, std::string(argv[1]) == "plan");
+        return 0;
+    }
+
     const std::vector<std::string> commands = {"inc", "dec", "dbl" };
 
     uint64_t half_money = getNumber();
@@ -3,15 +3,180 @@
 #include <string>
 #include <cctype>
 #include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+
+// Для произведений вида weight * cost, которые не помещаются в 64 бита
+#ifdef __SIZEOF_INT128__
+using uint128 = unsigned __int128;
+#else
+using uint128 = long double;
+#endif
 
 struct Item {
+    // Count of an item that can be taken any number of times
+    static constexpr uint64_t kUnlimited = std::numeric_limits<uint64_t>::max();
+
     uint64_t weight;
     uint64_t cost;
+    uint64_t count;
 
-    Item(uint64_t weight, uint64_t cost) : weight(weight), cost(cost) {
+    Item(uint64_t weight, uint64_t cost, uint64_t count = 1)
+        : weight(weight), cost(cost), count(count) {
     }
 };
 
+/* Обновление строки DP одним предметом (max-plus) на отрезке [begin, end):
+ * dst[j] = max(src[j], src[j - weight] + cost) для j >= weight, иначе src[j].
+ * j идет по убыванию, поэтому src и dst могут совпадать (одна строка in-place):
+ * читаются только индексы <= j, а записаны уже только индексы > j. Отрезки
+ * одной строки можно считать параллельно только при src != dst.
+ * Векторные версии грузят src[j..] и сдвинутый src[j - weight..], складывают и
+ * берут беззнаковый максимум (сравнение со сдвигом знакового бита).
+ */
+using RowKernel = void (*)(const uint64_t*, uint64_t*, uint64_t, uint64_t, uint64_t, uint64_t);
+
+void updateRowScalar(const uint64_t* src, uint64_t* dst, uint64_t begin, uint64_t end,
+                     uint64_t weight, uint64_t cost) {
+    for (uint64_t j = end; j > begin && j > weight;) {
+        --j;
+        uint64_t take = src[j - weight] + cost;
+        dst[j] = src[j] >= take ? src[j] : take;
+    }
+    if (src != dst && begin < std::min(weight, end)) {
+        std::copy(src + begin, src + std::min(weight, end), dst + begin);
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+__attribute__((target("sse4.2")))
+void updateRowSse42(const uint64_t* src, uint64_t* dst, uint64_t begin, uint64_t end,
+                    uint64_t weight, uint64_t cost) {
+    const __m128i sign = _mm_set1_epi64x(static_cast<int64_t>(1ULL << 63));
+    const __m128i add = _mm_set1_epi64x(static_cast<int64_t>(cost));
+    const uint64_t low = std::max(begin, weight);
+    uint64_t j = end;
+    while (j >= low + 2) {
+        j -= 2;
+        __m128i keep = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j));
+        __m128i take = _mm_add_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j - weight)), add);
+        __m128i greater = _mm_cmpgt_epi64(_mm_xor_si128(take, sign), _mm_xor_si128(keep, sign));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j), _mm_blendv_epi8(keep, take, greater));
+    }
+    updateRowScalar(src, dst, begin, j, weight, cost);
+}
+
+__attribute__((target("avx2")))
+void updateRowAvx2(const uint64_t* src, uint64_t* dst, uint64_t begin, uint64_t end,
+                   uint64_t weight, uint64_t cost) {
+    const __m256i sign = _mm256_set1_epi64x(static_cast<int64_t>(1ULL << 63));
+    const __m256i add = _mm256_set1_epi64x(static_cast<int64_t>(cost));
+    const uint64_t low = std::max(begin, weight);
+    uint64_t j = end;
+    while (j >= low + 4) {
+        j -= 4;
+        __m256i keep = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+        __m256i take = _mm256_add_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j - weight)), add);
+        __m256i greater = _mm256_cmpgt_epi64(_mm256_xor_si256(take, sign),
+                                             _mm256_xor_si256(keep, sign));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j),
+                            _mm256_blendv_epi8(keep, take, greater));
+    }
+    updateRowScalar(src, dst, begin, j, weight, cost);
+}
+#endif
+
+/* Строка DP для предмета из count копий: dst[j] = max по t <= count от
+ * src[j - t * weight] + t * cost. Индексы с одним остатком r = j mod weight
+ * образуют цепочку j = r + q * weight, где нужен максимум src[r + p * weight] -
+ * p * cost по окну p из [q - count, q]. Он поддерживается монотонной очередью
+ * номеров p (значения в ней убывают), поэтому каждая цепочка проходится за
+ * линию. count = Item::kUnlimited дает неограниченный рюкзак.
+ * src и dst должны различаться, queue - рабочий буфер.
+ *
+ * По времени: O(W) на предмет независимо от count.
+ */
+void updateRowBounded(const uint64_t* src, uint64_t* dst, uint64_t width, uint64_t weight,
+                      uint64_t cost, uint64_t count, std::vector<uint64_t>& queue) {
+    if (weight == 0) {
+        for (uint64_t j = 0; j < width; ++j) {
+            dst[j] = src[j] + count * cost;
+        }
+        return;
+    }
+    queue.resize((width - 1) / weight + 1);
+    // p1 < p2 is no better than p2 if src[p1] + (p2 - p1) * cost <= src[p2]
+    auto worse = [&](uint64_t j1, uint64_t p1, uint64_t j2, uint64_t p2) {
+        return src[j1] + static_cast<uint128>(p2 - p1) * cost <= src[j2];
+    };
+    for (uint64_t r = 0; r < weight && r < width; ++r) {
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        for (uint64_t q = 0, j = r; j < width; ++q, j += weight) {
+            while (tail > head && worse(r + queue[tail - 1] * weight, queue[tail - 1], j, q)) {
+                --tail;
+            }
+            queue[tail++] = q;
+            if (q - queue[head] > count) {
+                ++head;
+            }
+            uint64_t p = queue[head];
+            dst[j] = src[r + p * weight] + (q - p) * cost;
+        }
+    }
+}
+
+// Выбирается один раз по возможностям процессора
+RowKernel rowKernel() {
+    static const RowKernel kernel = []() -> RowKernel {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return updateRowAvx2;
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return updateRowSse42;
+        }
+#endif
+        return updateRowScalar;
+    }();
+    return kernel;
+}
+
+// Точка встречи потоков между предметами: никто не начинает следующую строку,
+// пока все не закончили текущую
+class Barrier {
+public:
+    explicit Barrier(unsigned count) : count_(count), waiting_(0), generation_(0) {
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t generation = generation_;
+        if (++waiting_ == count_) {
+            waiting_ = 0;
+            ++generation_;
+            cv_.notify_all();
+            return;
+        }
+        cv_.wait(lock, [this, generation] { return generation != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    unsigned count_;
+    unsigned waiting_;
+    uint64_t generation_;
+};
+
 class Backpack {
 public:
     explicit Backpack(uint64_t size);
@@ -19,22 +184,73 @@ public:
 
     void pack(const std::vector<uint64_t>&, const std::vector<uint64_t>&);
     void pack(std::vector<Item>& items);
+    // Item::count copies of each item, O(nW) with the monotone queue
+    void packBounded(std::vector<Item>& items);
+    // Any number of copies of each item, zero-weight items are taken once
+    void packUnbounded(std::vector<Item>& items);
+    // Cost at least (1 - epsilon) of the optimum, time and memory
+    // O(n * m^2 / epsilon) for m fitting items; see getEpsilon
+    void packApprox(std::vector<Item>& items, double epsilon);
+
+    // Above this many bytes the full DP table is replaced by rolling rows
+    void setMemoryLimit(uint64_t bytes) { memory_limit_ = bytes; }
+    // Threads for rows of at least kParallelMinWidth cells, 1 - sequential
+    void setThreads(unsigned threads) { threads_ = std::max(1U, threads); }
 
     std::vector<uint64_t> getNumbers() const { return numbers_; }
+    // Copies taken of each item from getNumbers(), all 1 in 0/1 modes
+    std::vector<uint64_t> getCounts() const { return counts_; }
     uint64_t getTotalWeight() const { return total_weight_; }
     uint64_t getTotalCost() const { return total_cost_; }
+    // No packing costs more than this, equals the total cost in exact modes
+    uint64_t getUpperBound() const { return upper_bound_; }
+    // Guaranteed cost >= (1 - getEpsilon()) * optimum: 0 in exact modes, above
+    // the requested epsilon if packApprox had to coarsen costs to fit memory
+    double getEpsilon() const { return epsilon_; }
 
 private:
+    static const uint64_t kDefaultMemoryLimit = 256ULL << 20;
+    static const uint64_t kParallelMinWidth = 1ULL << 18;
+    static const uint64_t kMaxDpCells = 1ULL << 33;
+    // Nodes given to the search per this many DP cells it replaces
+    static const uint64_t kCellsPerNode = 256;
+    static const uint64_t kMeetInMiddleMaxItems = 40;
+
     uint64_t size_;
     uint64_t norm_size_;
     uint64_t total_weight_;
     uint64_t total_cost_;
+    uint64_t upper_bound_;
+    double epsilon_;
+    uint64_t memory_limit_;
+    unsigned threads_;
     std::vector<Item> items_;
     std::vector<uint64_t> numbers_;
+    std::vector<uint64_t> counts_;
 
     static uint64_t gcd(uint64_t, uint64_t);
     std::vector<uint64_t> normWeights(const std::vector<Item>&);
-    void findNumbers(const std::vector<std::vector<uint64_t>>&, uint64_t, uint64_t,
+    void packTable(const std::vector<Item>&, const std::vector<uint64_t>&);
+    void packRolling(const std::vector<Item>&, const std::vector<uint64_t>&);
+    bool packBranchAndBound(const std::vector<Item>&, const std::vector<uint64_t>&, uint64_t);
+    void packMeetInMiddle(const std::vector<Item>&, const std::vector<uint64_t>&);
+    static uint64_t subsetSumBlock(uint64_t);
+    void packSubsetSum(const std::vector<Item>&, const std::vector<uint64_t>&);
+    std::vector<uint64_t> normCosts(const std::vector<Item>&, const std::vector<uint64_t>&) const;
+    void packByCost(const std::vector<Item>&, const std::vector<uint64_t>&,
+                    const std::vector<uint64_t>&, uint64_t);
+    void hirschberg(const std::vector<Item>&, const std::vector<uint64_t>&,
+                    uint64_t, uint64_t, uint64_t);
+    void fillRow(const std::vector<Item>&, const std::vector<uint64_t>&,
+                 uint64_t, uint64_t, std::vector<uint64_t>&) const;
+    unsigned threadsFor(uint64_t) const;
+    template <class Step>
+    void forEachStep(uint64_t, uint64_t, Step) const;
+    void packBoundedTable(const std::vector<Item>&, const std::vector<uint64_t>&,
+                          const std::vector<uint64_t>&);
+    void packBoundedSplit(const std::vector<Item>&, const std::vector<uint64_t>&);
+    void takeItem(const std::vector<Item>&, uint64_t, uint64_t copies = 1);
+    void findNumbers(const std::vector<uint64_t>&, uint64_t, uint64_t, uint64_t,
                      const std::vector<Item>&, const std::vector<uint64_t>&);
 };
 
@@ -43,6 +259,10 @@ Backpack::Backpack(uint64_t size) {
     norm_size_ = size;
     total_weight_ = 0;
     total_cost_ = 0;
+    upper_bound_ = 0;
+    epsilon_ = 0;
+    memory_limit_ = kDefaultMemoryLimit;
+    threads_ = std::max(1U, std::thread::hardware_concurrency());
 }
 
 void Backpack::pack(std::vector<Item>& items) {
@@ -50,22 +270,695 @@ void Backpack::pack(std::vector<Item>& items) {
         return;
     }
     std::vector<uint64_t> norm_weights = normWeights(items);
-    std::vector<std::vector<uint64_t>> dp(items.size() + 1, std::vector<uint64_t>(norm_size_ + 1, 0));
-    for (uint64_t i = 1; i <= items.size(); ++i) {
-        for (uint64_t j = 0; j <= norm_size_; ++j) {
-            if (norm_weights[i - 1] <= j) {
-                if (dp[i - 1][j] >= dp[i - 1][j - norm_weights[i - 1]] + items[i - 1].cost) {
-                    dp[i][j] = dp[i - 1][j];
-                } else {
-                    dp[i][j] = dp[i - 1][j - norm_weights[i - 1]] + items[i - 1].cost;
-                }
-            } else {
-                dp[i][j] = dp[i - 1][j];
+    // Capacity above the total weight changes nothing in the answer
+    uint64_t total_norm_weight = 0;
+    for (uint64_t i = 0; i < norm_weights.size() && total_norm_weight < norm_size_; ++i) {
+        if (norm_weights[i] <= norm_size_) {
+            total_norm_weight += std::min(norm_weights[i], norm_size_ - total_norm_weight);
+        }
+    }
+    norm_size_ = std::min(norm_size_, total_norm_weight);
+
+    // Table while it fits in memory, rows while one row fits; for more than
+    // kMaxDpCells cells the search goes first with a budget of nodes, and the
+    // rows are the fallback when it runs out. Unbounded search only when even
+    // one row does not fit
+    uint64_t width = norm_size_ + 1;
+    bool row_fits = width != 0 && width <= memory_limit_ / sizeof(uint64_t);
+    // cost == weight: only the reachable weights matter, one bit per weight
+    bool subset_sum = true;
+    for (uint64_t i = 0; i < items.size() && subset_sum; ++i) {
+        subset_sum = items[i].cost == items[i].weight;
+    }
+    uint64_t words = width / 64 + 1;
+    uint64_t block = subsetSumBlock(items.size());
+    // Small total cost: the table goes over costs instead of weights
+    std::vector<uint64_t> norm_costs = normCosts(items, norm_weights);
+    uint64_t cost_width = 1;
+    for (uint64_t i = 0; i < norm_costs.size() && cost_width < width; ++i) {
+        cost_width += std::min(norm_costs[i], width - cost_width);
+    }
+    // Few useful items: 2^(m/2) half-sums are cheaper than n * W cells
+    uint64_t useful = 0;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        useful += norm_weights[i] <= norm_size_ && items[i].cost > 0;
+    }
+    bool meet_in_middle = useful <= kMeetInMiddleMaxItems &&
+                          (width == 0 || (1ULL << (useful + 1) / 2) * 64 / items.size() < width);
+    if (subset_sum && width != 0 &&
+        words <= memory_limit_ / sizeof(uint64_t) / (items.size() / block + block + 2)) {
+        packSubsetSum(items, norm_weights);
+    } else if (cost_width < width &&
+        cost_width <= memory_limit_ / sizeof(uint64_t) / (items.size() + 1)) {
+        packByCost(items, norm_weights, norm_costs, cost_width);
+    } else if (meet_in_middle) {
+        packMeetInMiddle(items, norm_weights);
+    } else if (row_fits && width <= memory_limit_ / sizeof(uint64_t) / (items.size() + 1)) {
+        packTable(items, norm_weights);
+    } else if (row_fits && width <= kMaxDpCells / items.size()) {
+        packRolling(items, norm_weights);
+    } else if (!row_fits) {
+        packBranchAndBound(items, norm_weights, std::numeric_limits<uint64_t>::max());
+    } else {
+        uint128 budget = static_cast<uint128>(width) * items.size() / kCellsPerNode;
+        if (!packBranchAndBound(items, norm_weights,
+                                static_cast<uint64_t>(std::min<uint128>(
+                                    budget, std::numeric_limits<uint64_t>::max())))) {
+            packRolling(items, norm_weights);
+        }
+    }
+    upper_bound_ = total_cost_;
+}
+
+/* FPTAS: стоимости делятся на K = epsilon * P / m (P - максимальная стоимость,
+ * m - число помещающихся предметов) с округлением вниз, и задача решается
+ * точно DP по стоимости (packByCost). Сумма округленных стоимостей не больше
+ * m * P / K = m^2 / epsilon, а таблица packByCost - (n + 1) строк такой
+ * ширины, отсюда время и память O(n * m^2 / epsilon) независимо от W.
+ * На каждом предмете оптимума теряется меньше K, поэтому оптимум не больше
+ * total_cost_ + m * (K - 1) - это и есть верхняя оценка upper_bound_.
+ * Достигнутая точность epsilon_ = 1 - total_cost_ / upper_bound_: оптимум не
+ * больше оценки, а оценка не меньше P, так что epsilon_ <= m * (K - 1) / P,
+ * то есть не больше запрошенного.
+ * Если таблица не помещается в memory_limit_, K удваивается: ответ грубее,
+ * epsilon_ может стать больше запрошенного, и main об этом сообщает.
+ */
+void Backpack::packApprox(std::vector<Item>& items, double epsilon) {
+    if (items.size() == 0) {
+        return;
+    }
+    std::vector<uint64_t> norm_weights = normWeights(items);
+    uint64_t fitting = 0;
+    uint64_t max_cost = 0;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (norm_weights[i] <= norm_size_) {
+            ++fitting;
+            max_cost = std::max(max_cost, items[i].cost);
+        }
+    }
+    if (max_cost == 0) {
+        return;
+    }
+    long double scale = std::max<long double>(1, epsilon * max_cost / fitting);
+    uint64_t factor = scale >= max_cost ? max_cost : static_cast<uint64_t>(scale);
+
+    const uint64_t max_width = memory_limit_ / sizeof(uint64_t) / (items.size() + 1);
+    std::vector<uint64_t> scaled_costs(items.size(), 0);
+    uint64_t width = 0;
+    while (true) {
+        width = 1;
+        for (uint64_t i = 0; i < items.size(); ++i) {
+            scaled_costs[i] = norm_weights[i] <= norm_size_ ? items[i].cost / factor : 0;
+            width = std::min(max_width + 1, width + std::min(scaled_costs[i], max_width + 1));
+        }
+        if (width <= max_width || factor >= max_cost) {
+            break;
+        }
+        factor = factor > max_cost / 2 ? max_cost : factor * 2;
+    }
+    if (width > max_width) {
+        // Not even one unit per item fits, only the most valuable item is left
+        uint64_t best = 0;
+        while (norm_weights[best] > norm_size_) {
+            ++best;
+        }
+        for (uint64_t i = best + 1; i < items.size(); ++i) {
+            if (norm_weights[i] <= norm_size_ && items[i].cost > items[best].cost) {
+                best = i;
+            }
+        }
+        takeItem(items, best);
+        upper_bound_ = total_cost_ * fitting;
+    } else {
+        packByCost(items, norm_weights, scaled_costs, width);
+        upper_bound_ = total_cost_ + fitting * (factor - 1);
+    }
+    epsilon_ = 1 - static_cast<double>(total_cost_) / upper_bound_;
+}
+
+void Backpack::packTable(const std::vector<Item>& items, const std::vector<uint64_t>& norm_weights) {
+    // Rows lie one after another in a single buffer
+    const uint64_t width = norm_size_ + 1;
+    const RowKernel update_row = rowKernel();
+    std::vector<uint64_t> dp((items.size() + 1) * width, 0);
+    forEachStep(items.size(), width, [&](uint64_t i, uint64_t begin, uint64_t end) {
+        update_row(&dp[i * width], &dp[(i + 1) * width], begin, end,
+                   norm_weights[i], items[i].cost);
+    });
+    findNumbers(dp, width, items.size(), norm_size_, items, norm_weights);
+}
+
+/* Режим с памятью O(W): вместо таблицы (n+1) x (W+1) хранятся только строки
+ * DP, а набор предметов восстанавливается "разделяй и властвуй" (Хиршберг).
+ * Предметы делятся пополам, для каждой половины считается строка
+ * best[c] - максимальная стоимость при весе <= c, и ищется разбиение
+ * вместимости c + (W - c) с максимумом суммы. Дальше каждая половина решается
+ * со своей частью вместимости. Строки освобождаются до рекурсии.
+ *
+ * По времени: O(nW) с константой около 2-3 (на уровне рекурсии суммарная
+ * вместимость отрезков не больше W). По памяти: O(W + n).
+ * При равной стоимости набор может отличаться от табличного, итоговая
+ * стоимость совпадает.
+ */
+void Backpack::packRolling(const std::vector<Item>& items, const std::vector<uint64_t>& norm_weights) {
+    hirschberg(items, norm_weights, 0, items.size(), norm_size_);
+}
+
+void Backpack::hirschberg(const std::vector<Item>& items, const std::vector<uint64_t>& norm_weights,
+                          uint64_t begin, uint64_t end, uint64_t capacity) {
+    if (end - begin == 1) {
+        if (norm_weights[begin] <= capacity && items[begin].cost > 0) {
+            takeItem(items, begin);
+        }
+        return;
+    }
+    uint64_t mid = begin + (end - begin) / 2;
+    uint64_t left_capacity = 0;
+    {
+        std::vector<uint64_t> left(capacity + 1, 0);
+        std::vector<uint64_t> right(capacity + 1, 0);
+        fillRow(items, norm_weights, begin, mid, left);
+        fillRow(items, norm_weights, mid, end, right);
+        uint64_t best = 0;
+        for (uint64_t c = 0; c <= capacity; ++c) {
+            if (left[c] + right[capacity - c] > best) {
+                best = left[c] + right[capacity - c];
+                left_capacity = c;
             }
         }
     }
-    total_cost_ = dp[items.size()][norm_size_];
-    findNumbers(dp, items.size(), norm_size_, items, norm_weights);
+    hirschberg(items, norm_weights, begin, mid, left_capacity);
+    hirschberg(items, norm_weights, mid, end, capacity - left_capacity);
+}
+
+// 0/1 DP over items [begin, end) in one row, j goes down so each item is used once.
+// Wide rows are split between threads, then two buffers take turns
+void Backpack::fillRow(const std::vector<Item>& items, const std::vector<uint64_t>& norm_weights,
+                       uint64_t begin, uint64_t end, std::vector<uint64_t>& row) const {
+    uint64_t width = row.size();
+    const RowKernel update_row = rowKernel();
+    if (threadsFor(width) == 1) {
+        for (uint64_t i = begin; i < end; ++i) {
+            if (norm_weights[i] < width) {
+                update_row(row.data(), row.data(), 0, width, norm_weights[i], items[i].cost);
+            }
+        }
+        return;
+    }
+    std::vector<uint64_t> other(width);
+    uint64_t* buffers[2] = {row.data(), other.data()};
+    forEachStep(end - begin, width, [&](uint64_t step, uint64_t lo, uint64_t hi) {
+        uint64_t i = begin + step;
+        update_row(buffers[step % 2], buffers[(step + 1) % 2], lo, hi,
+                   norm_weights[i], items[i].cost);
+    });
+    if ((end - begin) % 2 == 1) {
+        row.swap(other);
+    }
+}
+
+unsigned Backpack::threadsFor(uint64_t width) const {
+    if (width < kParallelMinWidth) {
+        return 1;
+    }
+    return static_cast<unsigned>(std::min<uint64_t>(threads_, width / (kParallelMinWidth / 4)));
+}
+
+/* Вызывает step(i, lo, hi) для i из [0, steps), разбивая [0, width) между
+ * потоками на отрезки по границам кэш-линий. Шаг i + 1 начинается только
+ * после завершения шага i во всех потоках (барьер), поэтому строку i + 1
+ * можно считать по строке i.
+ */
+template <class Step>
+void Backpack::forEachStep(uint64_t steps, uint64_t width, Step step) const {
+    unsigned threads = threadsFor(width);
+    if (threads == 1) {
+        for (uint64_t i = 0; i < steps; ++i) {
+            step(i, 0, width);
+        }
+        return;
+    }
+    Barrier barrier(threads);
+    auto worker = [&](unsigned t) {
+        uint64_t lo = (width * t / threads) & ~7ULL;
+        uint64_t hi = t + 1 == threads ? width : (width * (t + 1) / threads) & ~7ULL;
+        for (uint64_t i = 0; i < steps; ++i) {
+            step(i, lo, hi);
+            barrier.wait();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+/* Точный перебор с отсечениями для огромных W (Horowitz-Sahni).
+ * Предметы сортируются по убыванию cost / weight, обход в глубину сначала
+ * кладет предмет, потом пропускает. Верхняя оценка - решение непрерывной
+ * задачи (Данциг): жадно целые предметы, затем дробная часть критического
+ * предмета; критический ищется бинарным поиском по префиксным суммам.
+ * Ветка отбрасывается, если оценка не больше лучшего найденного. Начальный
+ * рекорд - жадное решение, так что перебор идет около критического предмета.
+ *
+ * По памяти O(n), от W не зависит. По времени в худшем случае экспоненциально,
+ * на практике быстро, когда стоимости не скоррелированы с весами. Поэтому
+ * обход ограничен max_nodes вершинами: если их не хватило, ничего не кладется
+ * и возвращается false, чтобы pack досчитал строками DP.
+ */
+bool Backpack::packBranchAndBound(const std::vector<Item>& items,
+                                  const std::vector<uint64_t>& norm_weights, uint64_t max_nodes) {
+    std::vector<uint64_t> order;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (norm_weights[i] <= norm_size_ && items[i].cost > 0) {
+            order.push_back(i);
+        }
+    }
+    // a before b if cost_a / weight_a > cost_b / weight_b, zero weights first
+    std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+        return static_cast<uint128>(items[a].cost) * norm_weights[b] >
+               static_cast<uint128>(items[b].cost) * norm_weights[a];
+    });
+    const uint64_t m = order.size();
+    std::vector<uint128> prefix_weight(m + 1, 0);
+    std::vector<uint128> prefix_cost(m + 1, 0);
+    for (uint64_t k = 0; k < m; ++k) {
+        prefix_weight[k + 1] = prefix_weight[k] + norm_weights[order[k]];
+        prefix_cost[k + 1] = prefix_cost[k] + items[order[k]].cost;
+    }
+    auto bound = [&](uint64_t k, uint64_t capacity, uint128 cost) {
+        uint128 limit = prefix_weight[k] + capacity;
+        uint64_t r = std::upper_bound(prefix_weight.begin() + k, prefix_weight.end(), limit) -
+                     prefix_weight.begin() - 1;
+        uint128 result = cost + prefix_cost[r] - prefix_cost[k];
+        if (r < m) {
+            uint128 rest = limit - prefix_weight[r];
+            result += rest * items[order[r]].cost / norm_weights[order[r]];
+        }
+        return result;
+    };
+
+    std::vector<char> take(m, 0);
+    std::vector<char> best_take(m, 0);
+    uint128 best_cost = 0;
+    uint64_t capacity = norm_size_;
+    uint128 cost = 0;
+    uint64_t k = 0;
+    for (uint64_t nodes = 0;; ++nodes) {
+        if (nodes == max_nodes) {
+            return false;
+        }
+        if (k < m && bound(k, capacity, cost) > best_cost) {
+            uint64_t weight = norm_weights[order[k]];
+            take[k] = weight <= capacity;
+            if (take[k]) {
+                capacity -= weight;
+                cost += items[order[k]].cost;
+            }
+            ++k;
+            continue;
+        }
+        if (k == m && cost > best_cost) {
+            best_cost = cost;
+            best_take = take;
+        }
+        // Back to the last item that was put in and try without it
+        while (k > 0 && !take[k - 1]) {
+            --k;
+        }
+        if (k == 0) {
+            break;
+        }
+        --k;
+        take[k] = 0;
+        capacity += norm_weights[order[k]];
+        cost -= items[order[k]].cost;
+        ++k;
+    }
+
+    std::vector<uint64_t> chosen;
+    for (uint64_t k = 0; k < m; ++k) {
+        if (best_take[k]) {
+            chosen.push_back(order[k]);
+        }
+    }
+    std::sort(chosen.begin(), chosen.end());
+    for (uint64_t index : chosen) {
+        takeItem(items, index);
+    }
+    return true;
+}
+
+// Items between two saved bitset rows, about sqrt(n)
+uint64_t Backpack::subsetSumBlock(uint64_t n) {
+    uint64_t block = 1;
+    while (block * block < n) {
+        ++block;
+    }
+    return block;
+}
+
+// row |= row << shift for a bitset of row.size() words; j goes down, so the
+// words read (j - s and j - s - 1) are still the old ones
+void shiftOr(std::vector<uint64_t>& row, uint64_t shift) {
+    const uint64_t s = shift / 64;
+    const uint64_t b = shift % 64;
+    for (uint64_t j = row.size(); j > s;) {
+        --j;
+        uint64_t word = row[j - s] << b;
+        if (b != 0 && j > s) {
+            word |= row[j - s - 1] >> (64 - b);
+        }
+        row[j] |= word;
+    }
+}
+
+/* Путь для cost == weight (subset sum): нужна лишь достижимость веса, поэтому
+ * строка DP - битсет на W + 1 бит, и предмет добавляется одним сдвигом с OR
+ * по 64 веса за операцию. Ответ - старший достижимый бит.
+ * Для восстановления каждые B ~ sqrt(n) предметов сохраняется строка. Блоки
+ * разбираются с конца: строки блока пересчитываются от его контрольной точки,
+ * и если текущий вес недостижим без предмета i, предмет взят.
+ *
+ * По времени: O(nW / 64) на прямой проход и столько же на восстановление.
+ * По памяти: O((n / B + B) * W / 64) слов.
+ */
+void Backpack::packSubsetSum(const std::vector<Item>& items,
+                             const std::vector<uint64_t>& norm_weights) {
+    const uint64_t n = items.size();
+    const uint64_t width = norm_size_ + 1;
+    const uint64_t words = width / 64 + 1;
+    const uint64_t block = subsetSumBlock(n);
+    auto addItem = [&](std::vector<uint64_t>& row, uint64_t i) {
+        if (norm_weights[i] < width) {
+            shiftOr(row, norm_weights[i]);
+        }
+    };
+
+    std::vector<uint64_t> checkpoints;
+    std::vector<uint64_t> row(words, 0);
+    row[0] = 1;
+    for (uint64_t i = 0; i < n; ++i) {
+        if (i % block == 0) {
+            checkpoints.insert(checkpoints.end(), row.begin(), row.end());
+        }
+        addItem(row, i);
+    }
+    uint64_t target = norm_size_;
+    while (!(row[target / 64] >> (target % 64) & 1)) {
+        --target;
+    }
+
+    std::vector<uint64_t> chosen;
+    std::vector<uint64_t> rows(block * words);
+    for (uint64_t start = (n - 1) / block * block; target > 0; start -= block) {
+        uint64_t end = std::min(n, start + block);
+        // rows[k] - reachable weights before the item start + k
+        std::copy(checkpoints.begin() + start / block * words,
+                  checkpoints.begin() + (start / block + 1) * words, rows.begin());
+        for (uint64_t i = start; i + 1 < end; ++i) {
+            row.assign(rows.begin() + (i - start) * words, rows.begin() + (i - start + 1) * words);
+            addItem(row, i);
+            std::copy(row.begin(), row.end(), rows.begin() + (i - start + 1) * words);
+        }
+        for (uint64_t i = end; i > start && target > 0;) {
+            --i;
+            const uint64_t* before = &rows[(i - start) * words];
+            if (!(before[target / 64] >> (target % 64) & 1)) {
+                chosen.push_back(i);
+                target -= norm_weights[i];
+            }
+        }
+    }
+    for (uint64_t k = chosen.size(); k > 0; --k) {
+        takeItem(items, chosen[k - 1]);
+    }
+}
+
+/* Двойственная DP по стоимости: dp[i][c] - минимальный вес первых i
+ * предметов с суммарной стоимостью ровно c (бесконечность, если такой нет).
+ * Ответ - наибольшее c, для которого dp[n][c] <= W; набор восстанавливается
+ * по таблице так же, как в packTable. Выбирается, когда сумма стоимостей
+ * (после деления на их НОД) меньше вместимости.
+ *
+ * По времени: O(n * C), по памяти: O(n * C), где C - сумма стоимостей.
+ */
+void Backpack::packByCost(const std::vector<Item>& items, const std::vector<uint64_t>& norm_weights,
+                          const std::vector<uint64_t>& norm_costs, uint64_t width) {
+    const uint64_t infinity = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> dp((items.size() + 1) * width, infinity);
+    dp[0] = 0;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        const uint64_t* src = &dp[i * width];
+        uint64_t* dst = &dp[(i + 1) * width];
+        const uint64_t cost = norm_costs[i];
+        std::copy(src, src + width, dst);
+        if (cost == 0) {
+            continue;
+        }
+        // Weights above the capacity are as good as infinity and never overflow
+        const uint64_t limit = norm_size_ - norm_weights[i];
+        for (uint64_t c = cost; c < width; ++c) {
+            if (src[c - cost] <= limit) {
+                dst[c] = std::min(dst[c], src[c - cost] + norm_weights[i]);
+            }
+        }
+    }
+
+    uint64_t col = width - 1;
+    while (dp[items.size() * width + col] > norm_size_) {
+        --col;
+    }
+    std::vector<uint64_t> chosen;
+    for (uint64_t i = items.size(); i > 0 && col > 0; --i) {
+        if (dp[i * width + col] != dp[(i - 1) * width + col]) {
+            chosen.push_back(i - 1);
+            col -= norm_costs[i - 1];
+        }
+    }
+    for (uint64_t k = chosen.size(); k > 0; --k) {
+        takeItem(items, chosen[k - 1]);
+    }
+}
+
+// Costs divided by their gcd, 0 for the items that never fit
+std::vector<uint64_t> Backpack::normCosts(const std::vector<Item>& items,
+                                          const std::vector<uint64_t>& norm_weights) const {
+    uint64_t g = 0;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (norm_weights[i] <= norm_size_) {
+            g = gcd(g, items[i].cost);
+        }
+    }
+    std::vector<uint64_t> norm_costs(items.size(), 0);
+    for (uint64_t i = 0; i < items.size() && g != 0; ++i) {
+        if (norm_weights[i] <= norm_size_) {
+            norm_costs[i] = items[i].cost / g;
+        }
+    }
+    return norm_costs;
+}
+
+struct HalfSum {
+    uint64_t weight;
+    uint64_t cost;
+    uint32_t mask;
+};
+
+// All subsets of items[first..first + count) with weight <= capacity
+std::vector<HalfSum> enumerateHalf(const std::vector<Item>& items,
+                                   const std::vector<uint64_t>& norm_weights,
+                                   const std::vector<uint64_t>& useful,
+                                   uint64_t first, uint64_t count, uint64_t capacity) {
+    std::vector<HalfSum> sums{{0, 0, 0}};
+    sums.reserve(1ULL << count);
+    for (uint64_t k = 0; k < count; ++k) {
+        const uint64_t weight = norm_weights[useful[first + k]];
+        const uint64_t cost = items[useful[first + k]].cost;
+        for (uint64_t s = 0, size = sums.size(); s < size; ++s) {
+            if (sums[s].weight <= capacity - weight) {
+                sums.push_back({sums[s].weight + weight, sums[s].cost + cost,
+                                sums[s].mask | 1U << k});
+            }
+        }
+    }
+    return sums;
+}
+
+/* Встреча посередине для n <= 40 при любом W: предметы делятся на две
+ * половины, для каждой перебираются все подмножества с весом <= W.
+ * Правая половина сортируется по весу, и из нее убираются доминируемые
+ * (не легче и не дороже уже встреченного) - остается Парето-фронт, где с
+ * весом растет и стоимость. Левая половина сортируется по весу, и для нее
+ * двумя указателями находится самое тяжелое (а значит, самое дорогое)
+ * подходящее дополнение справа.
+ *
+ * По времени: O(2^(n/2) * n), по памяти: O(2^(n/2)).
+ */
+void Backpack::packMeetInMiddle(const std::vector<Item>& items,
+                                const std::vector<uint64_t>& norm_weights) {
+    std::vector<uint64_t> useful;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (norm_weights[i] <= norm_size_ && items[i].cost > 0) {
+            useful.push_back(i);
+        }
+    }
+    const uint64_t half = useful.size() / 2;
+    std::vector<HalfSum> left =
+        enumerateHalf(items, norm_weights, useful, 0, half, norm_size_);
+    std::vector<HalfSum> right =
+        enumerateHalf(items, norm_weights, useful, half, useful.size() - half, norm_size_);
+
+    auto lighter = [](const HalfSum& a, const HalfSum& b) {
+        return a.weight < b.weight || (a.weight == b.weight && a.cost > b.cost);
+    };
+    std::sort(left.begin(), left.end(), lighter);
+    std::sort(right.begin(), right.end(), lighter);
+    uint64_t front = 0;
+    for (uint64_t s = 1; s < right.size(); ++s) {
+        if (right[s].cost > right[front].cost) {
+            right[++front] = right[s];
+        }
+    }
+    right.resize(front + 1);
+
+    uint64_t best_cost = 0;
+    uint32_t best_left = 0;
+    uint32_t best_right = 0;
+    uint64_t r = right.size() - 1;
+    for (const HalfSum& sum : left) {
+        // Right part of the front only moves left while the left weight grows
+        while (right[r].weight > norm_size_ - sum.weight) {
+            --r;
+        }
+        if (sum.cost + right[r].cost > best_cost) {
+            best_cost = sum.cost + right[r].cost;
+            best_left = sum.mask;
+            best_right = right[r].mask;
+        }
+    }
+
+    for (uint64_t k = 0; k < useful.size(); ++k) {
+        bool taken = k < half ? best_left >> k & 1 : best_right >> (k - half) & 1;
+        if (taken) {
+            takeItem(items, useful[k]);
+        }
+    }
+}
+
+void Backpack::packBounded(std::vector<Item>& items) {
+    if (items.size() == 0) {
+        return;
+    }
+    std::vector<uint64_t> norm_weights = normWeights(items);
+    // More copies than fit are the same as exactly as many as fit
+    std::vector<uint64_t> counts(items.size());
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (norm_weights[i] == 0) {
+            counts[i] = items[i].count == Item::kUnlimited ? 1 : items[i].count;
+        } else {
+            counts[i] = std::min(items[i].count, norm_size_ / norm_weights[i]);
+        }
+    }
+    uint64_t width = norm_size_ + 1;
+    if (width != 0 && width <= memory_limit_ / sizeof(uint64_t) / (items.size() + 2)) {
+        packBoundedTable(items, norm_weights, counts);
+    } else {
+        packBoundedSplit(items, counts);
+    }
+    upper_bound_ = total_cost_;
+}
+
+void Backpack::packUnbounded(std::vector<Item>& items) {
+    std::vector<Item> unlimited;
+    for (const Item& item : items) {
+        unlimited.push_back(Item(item.weight, item.cost, Item::kUnlimited));
+    }
+    packBounded(unlimited);
+}
+
+// Full table of bounded rows; copies of item i are found by trying every t
+// that explains dp[i][j], which is O(W) per item at most
+void Backpack::packBoundedTable(const std::vector<Item>& items,
+                                const std::vector<uint64_t>& norm_weights,
+                                const std::vector<uint64_t>& counts) {
+    const uint64_t width = norm_size_ + 1;
+    std::vector<uint64_t> dp((items.size() + 1) * width, 0);
+    std::vector<uint64_t> queue;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        updateRowBounded(&dp[i * width], &dp[(i + 1) * width], width, norm_weights[i],
+                         items[i].cost, counts[i], queue);
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> chosen;
+    uint64_t col = norm_size_;
+    for (uint64_t i = items.size(); i > 0; --i) {
+        const uint64_t weight = norm_weights[i - 1];
+        const uint64_t cost = items[i - 1].cost;
+        uint64_t copies = 0;
+        if (weight == 0) {
+            copies = cost > 0 ? counts[i - 1] : 0;
+        } else {
+            while (dp[(i - 1) * width + col - copies * weight] + copies * cost !=
+                   dp[i * width + col]) {
+                ++copies;
+            }
+        }
+        if (copies > 0 && cost > 0) {
+            chosen.emplace_back(i - 1, copies);
+            col -= copies * weight;
+        }
+    }
+    for (uint64_t k = chosen.size(); k > 0; --k) {
+        takeItem(items, chosen[k - 1].first, chosen[k - 1].second);
+    }
+}
+
+/* Если таблица не помещается, count копий раскладываются на части 1, 2, 4, ...
+ * и остаток (любое число от 0 до count набирается из них), части решаются как
+ * обычный 0/1 рюкзак всеми режимами pack, и копии собираются обратно.
+ * По времени: O(nW log count).
+ */
+void Backpack::packBoundedSplit(const std::vector<Item>& items,
+                                const std::vector<uint64_t>& counts) {
+    std::vector<Item> parts;
+    std::vector<uint64_t> owner;
+    std::vector<uint64_t> multiplier;
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        uint64_t left = counts[i];
+        for (uint64_t part = 1; left > 0; part = std::min(part * 2, left)) {
+            parts.push_back(Item(items[i].weight * part, items[i].cost * part));
+            owner.push_back(i);
+            multiplier.push_back(part);
+            left -= part;
+        }
+    }
+    Backpack inner(size_);
+    inner.setMemoryLimit(memory_limit_);
+    inner.setThreads(threads_);
+    inner.pack(parts);
+
+    std::vector<uint64_t> copies(items.size(), 0);
+    for (uint64_t number : inner.getNumbers()) {
+        copies[owner[number - 1]] += multiplier[number - 1];
+    }
+    for (uint64_t i = 0; i < items.size(); ++i) {
+        if (copies[i] > 0) {
+            takeItem(items, i, copies[i]);
+        }
+    }
+}
+
+void Backpack::takeItem(const std::vector<Item>& items, uint64_t index, uint64_t copies) {
+    total_weight_ += items[index].weight * copies;
+    total_cost_ += items[index].cost * copies;
+    numbers_.push_back(index + 1);
+    counts_.push_back(copies);
+    items_.push_back(items[index]);
 }
 
 uint64_t Backpack::gcd(uint64_t a, uint64_t b) {
@@ -95,20 +988,21 @@ std::vector<uint64_t> Backpack::normWeights(const std::vector<Item>& items) {
     return norm_weights;
 }
 
-void Backpack::findNumbers(const std::vector<std::vector<uint64_t>>& dp, uint64_t number,
+// Walks the table back from the last row without recursion, the items come
+// out from the last one and are turned around in place at the end
+void Backpack::findNumbers(const std::vector<uint64_t>& dp, uint64_t width, uint64_t number,
                            uint64_t col, const std::vector<Item>& items,
                            const std::vector<uint64_t>& norm_weights) {
-    if (dp[number][col] == 0) {
-        return;
-    }
-    if (dp[number - 1][col] == dp[number][col]) {
-        findNumbers(dp, number - 1, col, items, norm_weights);
-    } else {
-        findNumbers(dp, number - 1, col - norm_weights[number - 1], items, norm_weights);
-        total_weight_ += items[number - 1].weight;
-        numbers_.push_back(number);
-        items_.push_back(items[number - 1]);
+    const uint64_t first = numbers_.size();
+    for (; number > 0 && dp[number * width + col] != 0; --number) {
+        if (dp[(number - 1) * width + col] != dp[number * width + col]) {
+            takeItem(items, number - 1);
+            col -= norm_weights[number - 1];
+        }
     }
+    std::reverse(numbers_.begin() + first, numbers_.end());
+    std::reverse(counts_.begin() + first, counts_.end());
+    std::reverse(items_.begin() + first, items_.end());
 }
 
 void skipSpaces(const std::string& line, uint64_t& pos) {
@@ -137,18 +1031,36 @@ bool getOneUint64_t(const std::string& line, uint64_t& number) {
     return pos == line.size();
 }
 
-bool getTwoUint64_t(const std::string& line, uint64_t& number_one, uint64_t& number_two) {
+// "weight cost" or "weight cost count", count "*" - any number of copies
+bool getItem(const std::string& line, uint64_t& weight, uint64_t& cost, uint64_t& count) {
     uint64_t pos = 0;
     skipSpaces(line, pos);
     if (pos == line.size() || !std::isdigit(line[pos])) {
         return false;
     }
-    number_one = getUint64_t(line, pos);
+    weight = getUint64_t(line, pos);
     skipSpaces(line, pos);
     if (pos == line.size() || !std::isdigit(line[pos])) {
         return false;
     }
-    number_two = getUint64_t(line, pos);
+    cost = getUint64_t(line, pos);
+    uint64_t cost_end = pos;
+    skipSpaces(line, pos);
+    count = 1;
+    if (pos == line.size()) {
+        return true;
+    }
+    if (pos == cost_end) {
+        return false;
+    }
+    if (line[pos] == '*') {
+        count = Item::kUnlimited;
+        ++pos;
+    } else if (std::isdigit(line[pos])) {
+        count = getUint64_t(line, pos);
+    } else {
+        return false;
+    }
     skipSpaces(line, pos);
     return pos == line.size();
 }
@@ -170,15 +1082,15 @@ uint64_t getBackpackSize() {
 
 std::vector<Item> getWeightsCosts() {
     std::string line;
-    uint64_t weight, cost;
+    uint64_t weight, cost, count;
     std::vector<Item> items;
     while (std::getline(std::cin, line)) {
         if (line.size() == 0) {
             continue;
         }
         if (line == "end") break;
-        if (getTwoUint64_t(line, weight, cost)) {
-            items.push_back(Item(weight, cost));
+        if (getItem(line, weight, cost, count)) {
+            items.push_back(Item(weight, cost, count));
         } else {
             std::cout << "error\n";
         }
@@ -186,10 +1098,29 @@ std::vector<Item> getWeightsCosts() {
     return items;
 }
 
-int main() {
+// Epsilon from the command line, 0 if it is not a number in (0, 1)
+double parseEpsilon(const char* arg) {
+    char* end = nullptr;
+    double epsilon = std::strtod(arg, &end);
+    if (end == arg || *end != '\0' || !(epsilon > 0 && epsilon < 1)) {
+        return 0;
+    }
+    return epsilon;
+}
+
+// Optional argument - epsilon of the approximate mode, e.g. "0.05".
+// Items with counts are packed as a bounded knapsack, then every line of the
+// answer is "number copies"
+int main(int argc, char* argv[]) {
     std::ios_base::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
+    double epsilon = argc > 1 ? parseEpsilon(argv[1]) : 0;
+    if (argc > 1 && epsilon == 0) {
+        std::cerr << "usage: " << argv[0] << " [epsilon], epsilon between 0 and 1\n";
+        return 1;
+    }
+
     uint64_t backpack_size = getBackpackSize();
     if (backpack_size == std::numeric_limits<uint64_t>::max()) {
         return 0;
@@ -197,12 +1128,37 @@ int main() {
 
     std::vector<Item> items = getWeightsCosts();
 
+    bool bounded = false;
+    for (const Item& item : items) {
+        bounded = bounded || item.count != 1;
+    }
+
     Backpack backpack(backpack_size);
-    backpack.pack(items);
-    
-    std::cout << backpack.getTotalWeight() << " " << backpack.getTotalCost() << "\n";
-    for (uint64_t number : backpack.getNumbers()) {
-        std::cout << number << "\n";
+    if (bounded) {
+        backpack.packBounded(items);
+    } else if (argc > 1) {
+        backpack.packApprox(items, epsilon);
+    } else {
+        backpack.pack(items);
+    }
+
+    if (argc > 1 && !bounded && backpack.getEpsilon() > epsilon) {
+        std::cerr << "epsilon raised to " << backpack.getEpsilon()
+                  << ": the cost table for the requested one does not fit in memory\n";
+    }
+    std::cout << backpack.getTotalWeight() << " " << backpack.getTotalCost();
+    if (argc > 1) {
+        std::cout << " " << backpack.getUpperBound();
+    }
+    std::cout << "\n";
+    std::vector<uint64_t> numbers = backpack.getNumbers();
+    std::vector<uint64_t> counts = backpack.getCounts();
+    for (uint64_t k = 0; k < numbers.size(); ++k) {
+        std::cout << numbers[k];
+        if (bounded) {
+            std::cout << " " << counts[k];
+        }
+        std::cout << "\n";
     }
 
     return 0;
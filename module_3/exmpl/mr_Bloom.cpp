@@ -3,35 +3,82 @@
 #include <string>
 #include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <new>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
 
 class BitArray {
 public:
     explicit BitArray(uint64_t);
+    // Read-only view of words owned by someone else, e.g. a mapped file
+    BitArray(const uint64_t* words, uint64_t number_bits);
     ~BitArray();
 
     void setBit(uint64_t);
+    void clearBit(uint64_t);
     bool isBitOne(uint64_t) const;
+    uint64_t popCount() const;
+    // Word by word, both arrays must be of the same length
+    void unite(const BitArray&);
+    void intersect(const BitArray&);
+    uint64_t getNumberBits() const { return number_bits_; }
+    // Safe to call from several threads at once: relaxed atomic or / load
+    void setBitAtomic(uint64_t);
+    bool isBitOneAtomic(uint64_t) const;
+    // Starts loading the word of the bit into the cache without waiting for it
+    void prefetch(uint64_t index, bool for_write) const;
     std::string toString() const;
+    const uint64_t* data() const { return buffer_; }
+    uint64_t sizeInWords() const { return size_; }
+
+    // The buffer starts on a cache line, so do blocks of kLineBits
+    static const uint64_t kLineBits = 512;
 
 private:
     static const uint64_t kTypeSize = sizeof(uint64_t) * 8;
+    static const std::size_t kAlignment = kLineBits / 8;
 
     uint64_t* buffer_;
     uint64_t number_bits_;
     uint64_t size_;
+    bool owned_;
 };
 
 BitArray::BitArray(uint64_t number_bits) {
     number_bits_ = number_bits;
     size_ = (number_bits_ + kTypeSize - 1ULL) / kTypeSize;
-    buffer_ = new uint64_t[size_];
+    buffer_ = static_cast<uint64_t*>(
+        ::operator new[](size_ * sizeof(uint64_t), std::align_val_t(kAlignment)));
     for (uint64_t i = 0; i < size_; ++i) {
         buffer_[i] = 0;
     }
+    owned_ = true;
+}
+
+BitArray::BitArray(const uint64_t* words, uint64_t number_bits) {
+    number_bits_ = number_bits;
+    size_ = (number_bits_ + kTypeSize - 1ULL) / kTypeSize;
+    buffer_ = const_cast<uint64_t*>(words);
+    owned_ = false;
 }
 
 BitArray::~BitArray() {
-    delete[] buffer_;
+    if (owned_) {
+        ::operator delete[](buffer_, std::align_val_t(kAlignment));
+    }
 }
 
 void BitArray::setBit(uint64_t index) {
@@ -40,23 +87,77 @@ void BitArray::setBit(uint64_t index) {
     buffer_[int_index] |= (1ULL << (kTypeSize - 1ULL - bit_index));
 }
 
+void BitArray::clearBit(uint64_t index) {
+    buffer_[index / kTypeSize] &= ~(1ULL << (kTypeSize - 1ULL - index % kTypeSize));
+}
+
+uint64_t BitArray::popCount() const {
+    uint64_t ones = 0;
+    for (uint64_t i = 0; i < size_; ++i) {
+        ones += __builtin_popcountll(buffer_[i]);
+    }
+    return ones;
+}
+
+void BitArray::unite(const BitArray& other) {
+    for (uint64_t i = 0; i < size_; ++i) {
+        buffer_[i] |= other.buffer_[i];
+    }
+}
+
+void BitArray::intersect(const BitArray& other) {
+    for (uint64_t i = 0; i < size_; ++i) {
+        buffer_[i] &= other.buffer_[i];
+    }
+}
+
 bool BitArray::isBitOne(uint64_t index) const {
     uint64_t int_index = index / kTypeSize;
     uint64_t bit_index = index % kTypeSize;
     return (buffer_[int_index] | (1ULL << (kTypeSize - 1ULL - bit_index))) == buffer_[int_index];
 }
 
+void BitArray::setBitAtomic(uint64_t index) {
+    uint64_t mask = 1ULL << (kTypeSize - 1ULL - index % kTypeSize);
+    __atomic_fetch_or(&buffer_[index / kTypeSize], mask, __ATOMIC_RELAXED);
+}
+
+bool BitArray::isBitOneAtomic(uint64_t index) const {
+    uint64_t mask = 1ULL << (kTypeSize - 1ULL - index % kTypeSize);
+    return (__atomic_load_n(&buffer_[index / kTypeSize], __ATOMIC_RELAXED) & mask) != 0;
+}
+
+void BitArray::prefetch(uint64_t index, bool for_write) const {
+    if (for_write) {
+        __builtin_prefetch(buffer_ + index / kTypeSize, 1);
+    } else {
+        __builtin_prefetch(buffer_ + index / kTypeSize, 0);
+    }
+}
+
+// Bits of a byte as 8 chars from the high one, so a byte is one copy
+struct ByteStrings {
+    char chars[256][8];
+
+    ByteStrings() {
+        for (int byte = 0; byte < 256; ++byte) {
+            for (int bit = 0; bit < 8; ++bit) {
+                chars[byte][bit] = (byte >> (7 - bit) & 1) ? '1' : '0';
+            }
+        }
+    }
+};
+
 std::string BitArray::toString() const {
-    std::string bits;
-    bits.reserve(number_bits_);
+    static const ByteStrings table;
+    std::string bits(size_ * kTypeSize, '0');
+    char* out = &bits[0];
     for (uint64_t i = 0; i < size_; ++i) {
-        uint64_t bit_number = kTypeSize;
-        while (bits.size() < number_bits_ && bit_number > 0) {
-            uint64_t bit = buffer_[i] & (1ULL << (bit_number - 1ULL));
-            bits += (bit ? '1' : '0');
-            --bit_number;
+        for (int shift = kTypeSize - 8; shift >= 0; shift -= 8, out += 8) {
+            std::memcpy(out, table.chars[buffer_[i] >> shift & 0xff], 8);
         }
     }
+    bits.resize(number_bits_);
     return bits;
 }
 
@@ -76,54 +177,348 @@ private:
     std::string msg_;
 };
 
+// 64-bit finalizer from splitmix64: every input bit affects every output bit
+inline uint64_t mixHash(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Maps a uniform 64-bit hash to [0, range) with a multiply instead of a modulo
+inline uint64_t fastRange(uint64_t hash, uint64_t range) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * range) >> 64);
+}
+
+/* kFlat - каждый из k битов ключа в любом месте массива (формат задачи,
+ * print совпадает с эталоном), k промахов кэша на операцию.
+ * kBlocked - ключ сначала выбирает блок в одну кэш-линию (512 бит), и все k
+ * битов ставятся внутри него: один промах на операцию. Биты в блоке ложатся
+ * неравномерно, поэтому ложных срабатываний чуть больше, чем у kFlat того же
+ * размера.
+ */
+enum class BloomLayout { kFlat, kBlocked };
+
+/* Как получить k индексов для kFlat.
+ * kPrimes - формула задачи ((1 + i) * x + prime_i) mod (2^31 - 1) mod m: два
+ * деления на проверку и простые числа при создании; нужен для print.
+ * kDouble - Кирш-Митценмахер: один 64-битный хеш h, вторая половина g
+ * (нечетная) и индексы h + i * g, сведенные в [0, m) умножением. Ложные
+ * срабатывания асимптотически те же, что у k независимых хешей.
+ * kBlocked всегда берет смещения из одного 64-битного хеша.
+ */
+enum class BloomHashing { kPrimes, kDouble };
+
+// Whole file mapped read-only; pages are shared by every process that maps it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw BloomFilterException("cannot open " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size_ = info.st_size;
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data_ == nullptr || data_ == MAP_FAILED) {
+            throw BloomFilterException("cannot map " + path);
+        }
+    }
+    ~MappedFile() {
+        munmap(data_, size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return static_cast<const char*>(data_); }
+    uint64_t size() const { return size_; }
+
+private:
+    void* data_;
+    uint64_t size_;
+};
+
 class BloomFilter {
 public:
-    BloomFilter(uint64_t, double);
+    BloomFilter(uint64_t, double, BloomLayout layout = BloomLayout::kFlat,
+                BloomHashing hashing = BloomHashing::kDouble);
     ~BloomFilter();
 
+    /* Двоичный файл фильтра: заголовок из 64 байт (FileHeader) и сразу за ним
+     * слова BitArray как есть, в порядке байтов машины. Заголовок кратен
+     * кэш-линии, а mmap отдает начало страницы, поэтому в отображении блоки
+     * kBlocked тоже лежат по кэш-линиям.
+     * open отображает файл только для чтения: search работает прямо по
+     * страницам файла без копирования, add бросает исключение.
+     */
+    void save(const std::string& path) const;
+    static BloomFilter* open(const std::string& path);
+    inline bool isReadOnly() const { return mapping_ != nullptr; }
+
     void add(uint64_t);
     bool search(uint64_t) const;
+    // The same for count keys; bit j of found (from the low one) - search(keys[j])
+    void addBatch(const uint64_t* keys, uint64_t count);
+    void searchBatch(const uint64_t* keys, uint64_t count, uint64_t* found) const;
 
     inline uint64_t getSize() const { return size_; }
     inline uint64_t getNumberHashes() const { return number_hashes_; }
+    inline BloomLayout getLayout() const { return layout_; }
+    inline BloomHashing getHashing() const { return hashing_; }
+    /* В параллельном режиме add и search можно вызывать из многих потоков
+     * без блокировок: бит ставится атомарным fetch_or, поэтому ни одна
+     * вставка не теряется, а search читает слова атомарно. Порядок не нужен:
+     * биты только появляются, и search, увидевший бит, верен в любом случае.
+     * Включается до начала общей работы.
+     */
+    inline void setConcurrent(bool concurrent) { concurrent_ = concurrent; }
+    inline bool isConcurrent() const { return concurrent_; }
+
+    // (доля единичных битов)^k - вероятность, что все k битов случайного
+    // отсутствующего ключа уже стоят
+    double estimatedFalsePositiveRate() const;
+    // Число различных добавленных ключей по числу единиц X (Swamidass, Baldi):
+    // n = -(m / k) ln(1 - X / m)
+    double estimatedCardinality() const;
+    uint64_t popCount() const { return bit_array_->popCount(); }
+
+    /* Объединение и пересечение фильтров с одинаковыми параметрами (размер,
+     * k, раскладка, хеширование), например шардов одного набора. После
+     * unite фильтр отвечает как фильтр по объединению ключей; после
+     * intersect - не хуже фильтра по пересечению (ложных срабатываний может
+     * быть больше). Иначе бросается BloomFilterException.
+     */
+    void unite(const BloomFilter&);
+    void intersect(const BloomFilter&);
 
     friend std::ostream& operator<<(std::ostream&, const BloomFilter&);
+    friend class CommandPipeline;
+
+protected:
+    BitArray* bit_array_;
+
+    template <class Probe>
+    bool forEachBit(uint64_t, Probe) const;
 
 private:
     static const uint64_t kMersenThirtyOne = 2147483647;
+    // p = 2^-64 is already far below anything a 64-bit hash can tell apart
+    static const uint64_t kMaxHashes = 64;
+    // Bit offsets inside a block are taken 9 bits at a time from one hash
+    static const uint64_t kBlockOffsetBits = 9;
+    static const uint64_t kOffsetsPerHash = 64 / kBlockOffsetBits;
+    // Keys whose bits are prefetched before any of them is touched
+    static constexpr uint64_t kBatchGroup = 16;
+
+    struct FileHeader {
+        char magic[8];
+        uint64_t size;
+        uint64_t number_hashes;
+        uint32_t layout;
+        uint32_t hashing;
+        uint64_t reserved[4];
+    };
+    static constexpr char kFileMagic[8] = "BLOOMF1";
 
+    BloomLayout layout_;
+    BloomHashing hashing_;
+    bool concurrent_;
     uint64_t number_hashes_;
     uint64_t size_;
     std::vector<uint64_t> prime_numbers_;
-    BitArray* bit_array_;
+    MappedFile* mapping_;
 
+    BloomFilter() = default;
     uint64_t hash_(uint64_t, uint64_t) const;
+    void setBit_(uint64_t) const;
+    bool isBitOne_(uint64_t) const;
+    uint64_t blockStart(uint64_t) const;
+    static uint64_t blockOffset(uint64_t&, uint64_t);
+    void checkCompatible(const BloomFilter&) const;
+    uint64_t collectBits(const uint64_t*, uint64_t, std::vector<uint64_t>&, bool) const;
     std::vector<uint64_t> getPrimeNumbers() const;
 };
 
-BloomFilter::BloomFilter(uint64_t size, double p) {
+BloomFilter::BloomFilter(uint64_t size, double p, BloomLayout layout, BloomHashing hashing) {
+    layout_ = layout;
+    hashing_ = hashing;
+    concurrent_ = false;
     number_hashes_ = (uint64_t)round(-log2(p));
-    if (number_hashes_ == 0) {
+    if (number_hashes_ == 0 || number_hashes_ > kMaxHashes) {
         throw BloomFilterException("error");
     }
     size_ = (uint64_t)round(size * (-log2(p) / log(2)));
-    prime_numbers_ = getPrimeNumbers();
+    if (layout_ == BloomLayout::kBlocked) {
+        size_ = (size_ + BitArray::kLineBits - 1) / BitArray::kLineBits * BitArray::kLineBits;
+    }
+    if (layout_ == BloomLayout::kFlat && hashing_ == BloomHashing::kPrimes) {
+        prime_numbers_ = getPrimeNumbers();
+    }
     bit_array_ = new BitArray(size_);
+    mapping_ = nullptr;
 }
 
 BloomFilter::~BloomFilter() {
     delete bit_array_;
+    delete mapping_;
+}
+
+void BloomFilter::save(const std::string& path) const {
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+    header.size = size_;
+    header.number_hashes = number_hashes_;
+    header.layout = static_cast<uint32_t>(layout_);
+    header.hashing = static_cast<uint32_t>(hashing_);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(bit_array_->data()),
+              bit_array_->sizeInWords() * sizeof(uint64_t));
+    if (!out) {
+        throw BloomFilterException("cannot write " + path);
+    }
+}
+
+BloomFilter* BloomFilter::open(const std::string& path) {
+    MappedFile* mapping = new MappedFile(path);
+    FileHeader header;
+    bool valid = mapping->size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, mapping->data(), sizeof(header));
+        // Compared in bits so that a forged size cannot wrap around
+        uint64_t file_bits = (mapping->size() - sizeof(header)) / sizeof(uint64_t) * 64;
+        valid = std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) == 0 &&
+                header.number_hashes > 0 && header.number_hashes <= kMaxHashes &&
+                header.size > 0 && header.size <= file_bits &&
+                header.layout <= static_cast<uint32_t>(BloomLayout::kBlocked) &&
+                header.hashing <= static_cast<uint32_t>(BloomHashing::kDouble);
+        // Blocks are whole cache lines, a partial last one would be read past the end
+        valid = valid && (header.layout != static_cast<uint32_t>(BloomLayout::kBlocked) ||
+                          header.size % BitArray::kLineBits == 0);
+    }
+    if (!valid) {
+        delete mapping;
+        throw BloomFilterException("bad filter file " + path);
+    }
+    BloomFilter* filter = new BloomFilter();
+    filter->layout_ = static_cast<BloomLayout>(header.layout);
+    filter->hashing_ = static_cast<BloomHashing>(header.hashing);
+    filter->concurrent_ = false;
+    filter->number_hashes_ = header.number_hashes;
+    filter->size_ = header.size;
+    if (filter->layout_ == BloomLayout::kFlat && filter->hashing_ == BloomHashing::kPrimes) {
+        filter->prime_numbers_ = filter->getPrimeNumbers();
+    }
+    filter->bit_array_ = new BitArray(
+        reinterpret_cast<const uint64_t*>(mapping->data() + sizeof(header)), header.size);
+    filter->mapping_ = mapping;
+    return filter;
 }
 
 void BloomFilter::add(uint64_t key) {
-    for (uint64_t i = 0; i < number_hashes_; ++i) {
-        bit_array_->setBit(hash_(i, key));
+    if (isReadOnly()) {
+        throw BloomFilterException("read-only filter");
     }
+    forEachBit(key, [this](uint64_t bit) {
+        setBit_(bit);
+        return true;
+    });
 }
 
 bool BloomFilter::search(uint64_t key) const {
+    return forEachBit(key, [this](uint64_t bit) { return isBitOne_(bit); });
+}
+
+void BloomFilter::setBit_(uint64_t bit) const {
+    if (concurrent_) {
+        bit_array_->setBitAtomic(bit);
+    } else {
+        bit_array_->setBit(bit);
+    }
+}
+
+bool BloomFilter::isBitOne_(uint64_t bit) const {
+    return concurrent_ ? bit_array_->isBitOneAtomic(bit) : bit_array_->isBitOne(bit);
+}
+
+/* Пакетные операции прячут задержку памяти: для группы из kBatchGroup
+ * ключей сначала считаются все индексы битов и на каждый выдается prefetch,
+ * и только потом биты читаются или ставятся. Пока процессор ждет первый
+ * промах, остальные строки уже едут из памяти.
+ */
+void BloomFilter::addBatch(const uint64_t* keys, uint64_t count) {
+    if (isReadOnly()) {
+        throw BloomFilterException("read-only filter");
+    }
+    std::vector<uint64_t> bits(kBatchGroup * number_hashes_);
+    for (uint64_t first = 0; first < count; first += kBatchGroup) {
+        uint64_t group = collectBits(keys + first, std::min(kBatchGroup, count - first), bits,
+                                     true);
+        for (uint64_t j = 0; j < group * number_hashes_; ++j) {
+            setBit_(bits[j]);
+        }
+    }
+}
+
+void BloomFilter::searchBatch(const uint64_t* keys, uint64_t count, uint64_t* found) const {
+    std::fill(found, found + (count + 63) / 64, 0);
+    std::vector<uint64_t> bits(kBatchGroup * number_hashes_);
+    for (uint64_t first = 0; first < count; first += kBatchGroup) {
+        uint64_t group = collectBits(keys + first, std::min(kBatchGroup, count - first), bits,
+                                     false);
+        for (uint64_t g = 0; g < group; ++g) {
+            bool all_one = true;
+            for (uint64_t i = 0; i < number_hashes_ && all_one; ++i) {
+                all_one = isBitOne_(bits[g * number_hashes_ + i]);
+            }
+            found[(first + g) / 64] |= static_cast<uint64_t>(all_one) << ((first + g) % 64);
+        }
+    }
+}
+
+// Bits of group keys one key after another, every one already prefetched
+uint64_t BloomFilter::collectBits(const uint64_t* keys, uint64_t group,
+                                  std::vector<uint64_t>& bits, bool for_write) const {
+    uint64_t size = 0;
+    for (uint64_t g = 0; g < group; ++g) {
+        forEachBit(keys[g], [&](uint64_t bit) {
+            bit_array_->prefetch(bit, for_write);
+            bits[size++] = bit;
+            return true;
+        });
+    }
+    return group;
+}
+
+// Calls probe for every bit of the key until it returns false
+template <class Probe>
+bool BloomFilter::forEachBit(uint64_t key, Probe probe) const {
+    if (layout_ == BloomLayout::kBlocked) {
+        uint64_t start = blockStart(key);
+        uint64_t offsets = mixHash(key ^ start);
+        for (uint64_t i = 0; i < number_hashes_; ++i) {
+            if (!probe(start + blockOffset(offsets, i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (hashing_ == BloomHashing::kDouble) {
+        uint64_t hash = mixHash(key);
+        uint64_t step = mixHash(hash) | 1;
+        for (uint64_t i = 0; i < number_hashes_; ++i, hash += step) {
+            if (!probe(fastRange(hash, size_))) {
+                return false;
+            }
+        }
+        return true;
+    }
     for (uint64_t i = 0; i < number_hashes_; ++i) {
-        if (!bit_array_->isBitOne(hash_(i, key))) {
+        if (!probe(hash_(i, key))) {
             return false;
         }
     }
@@ -155,11 +550,291 @@ uint64_t BloomFilter::hash_(uint64_t i, uint64_t x) const {
     return (((1 + i) * x + prime_numbers_[i]) % kMersenThirtyOne) % size_;
 }
 
+// First bit of the block that holds all bits of the key
+uint64_t BloomFilter::blockStart(uint64_t key) const {
+    return fastRange(mixHash(key), size_ / BitArray::kLineBits) * BitArray::kLineBits;
+}
+
+// i-th offset inside the block; the hash is mixed again once its bits run out
+uint64_t BloomFilter::blockOffset(uint64_t& offsets, uint64_t i) {
+    if (i != 0 && i % kOffsetsPerHash == 0) {
+        offsets = mixHash(offsets);
+    }
+    return (offsets >> (i % kOffsetsPerHash * kBlockOffsetBits)) & (BitArray::kLineBits - 1);
+}
+
+double BloomFilter::estimatedCardinality() const {
+    double fill = static_cast<double>(bit_array_->popCount()) / size_;
+    if (fill >= 1) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return -static_cast<double>(size_) / number_hashes_ * std::log1p(-fill);
+}
+
+void BloomFilter::unite(const BloomFilter& other) {
+    checkCompatible(other);
+    bit_array_->unite(*other.bit_array_);
+}
+
+void BloomFilter::intersect(const BloomFilter& other) {
+    checkCompatible(other);
+    bit_array_->intersect(*other.bit_array_);
+}
+
+void BloomFilter::checkCompatible(const BloomFilter& other) const {
+    if (isReadOnly()) {
+        throw BloomFilterException("read-only filter");
+    }
+    if (size_ != other.size_ || number_hashes_ != other.number_hashes_ ||
+        layout_ != other.layout_ || hashing_ != other.hashing_) {
+        throw BloomFilterException("filters differ");
+    }
+}
+
+double BloomFilter::estimatedFalsePositiveRate() const {
+    double fill = static_cast<double>(bit_array_->popCount()) / size_;
+    return std::pow(fill, static_cast<double>(number_hashes_));
+}
+
 std::ostream& operator<<(std::ostream& out, const BloomFilter& filter) {
     out << filter.bit_array_->toString();
     return out;
 }
 
+/* Считающий фильтр: к каждому биту фильтра приписан 4-битный счетчик (по 16
+ * в слове), поэтому ключи можно удалять. Биты BitArray остаются признаком
+ * "счетчик не ноль", так что search тот же, что у BloomFilter. Счетчик,
+ * дошедший до 15, больше не меняется: удаление не должно обнулить бит,
+ * который держат другие ключи. Удалять можно только добавленные ключи.
+ *
+ * По памяти: в 5 раз больше обычного фильтра.
+ */
+class CountingBloomFilter : private BloomFilter {
+public:
+    CountingBloomFilter(uint64_t size, double p, BloomLayout layout = BloomLayout::kFlat)
+        : BloomFilter(size, p, layout), counters_((getSize() + 15) / 16, 0) {
+    }
+
+    void add(uint64_t key) {
+        forEachBit(key, [this](uint64_t bit) {
+            uint64_t shift = bit % 16 * 4;
+            if ((counters_[bit / 16] >> shift & kMaxCounter) != kMaxCounter) {
+                counters_[bit / 16] += 1ULL << shift;
+            }
+            bit_array_->setBit(bit);
+            return true;
+        });
+    }
+
+    // false, if the key is surely absent and nothing was changed
+    bool remove(uint64_t key) {
+        if (!search(key)) {
+            return false;
+        }
+        forEachBit(key, [this](uint64_t bit) {
+            uint64_t shift = bit % 16 * 4;
+            uint64_t counter = counters_[bit / 16] >> shift & kMaxCounter;
+            if (counter != kMaxCounter) {
+                counters_[bit / 16] -= 1ULL << shift;
+                if (counter == 1) {
+                    bit_array_->clearBit(bit);
+                }
+            }
+            return true;
+        });
+        return true;
+    }
+
+    using BloomFilter::search;
+    using BloomFilter::getSize;
+    using BloomFilter::getNumberHashes;
+    using BloomFilter::estimatedFalsePositiveRate;
+
+private:
+    static const uint64_t kMaxCounter = 15;
+
+    std::vector<uint64_t> counters_;
+};
+
+/* Масштабируемый фильтр (Almeida и др.): цепочка фильтров, каждый следующий
+ * вдвое больше по числу ключей и с вдвое меньшей вероятностью ошибки
+ * p_i = p * (1 - r) * r^i, r = 1/2. Сумма p_i не больше p, поэтому общая
+ * ошибка остается в пределах p при любом числе ключей. Новые ключи идут в
+ * последний фильтр, search спрашивает все.
+ */
+class ScalableBloomFilter {
+public:
+    ScalableBloomFilter(uint64_t size, double p, BloomLayout layout = BloomLayout::kFlat)
+        : layout_(layout), next_size_(size), next_p_(p * (1 - kTightening)), count_(0),
+          capacity_(0) {
+        grow();
+    }
+
+    void add(uint64_t key) {
+        if (count_ == capacity_) {
+            grow();
+        }
+        filters_.back()->add(key);
+        ++count_;
+    }
+
+    bool search(uint64_t key) const {
+        for (const std::unique_ptr<BloomFilter>& filter : filters_) {
+            if (filter->search(key)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 1 - П(1 - p_i) по текущему заполнению каждого фильтра
+    double estimatedFalsePositiveRate() const {
+        double miss = 1;
+        for (const std::unique_ptr<BloomFilter>& filter : filters_) {
+            miss *= 1 - filter->estimatedFalsePositiveRate();
+        }
+        return 1 - miss;
+    }
+
+    uint64_t getNumberFilters() const { return filters_.size(); }
+
+private:
+    static constexpr double kTightening = 0.5;
+    static const uint64_t kGrowth = 2;
+
+    BloomLayout layout_;
+    uint64_t next_size_;
+    double next_p_;
+    uint64_t count_;
+    uint64_t capacity_;
+    std::vector<std::unique_ptr<BloomFilter>> filters_;
+
+    void grow() {
+        filters_.emplace_back(new BloomFilter(next_size_, next_p_, layout_));
+        capacity_ += next_size_;
+        next_size_ *= kGrowth;
+        next_p_ *= kTightening;
+    }
+};
+
+/* Xor-фильтр (Graf, Lemire): статическая замена BloomFilter для набора ключей,
+ * известного заранее. Таблица из трех равных сегментов, ~1.23n ячеек по
+ * Fingerprint (8 или 16 бит). Ключ задает по ячейке в каждом сегменте и
+ * отпечаток f; строится так, чтобы xor трех ячеек был равен f. search - три
+ * чтения и сравнение, ошибка 2^-bits, память ~1.23 * bits бит на ключ (у
+ * BloomFilter с той же ошибкой ~1.44 * bits).
+ * Построение - "очистка" гиперграфа: ячейка, куда попал ровно один ключ,
+ * закрепляется за ним, ключ убирается, и так далее; значения расставляются
+ * в обратном порядке. Если очистка застряла (редко), берется другое зерно.
+ *
+ * По времени построения: O(n) в среднем, по памяти: O(n).
+ */
+template <class Fingerprint>
+class XorFilter {
+public:
+    explicit XorFilter(std::vector<uint64_t> keys) {
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        block_length_ = (keys.size() * 123 / 100 + 32) / 3 + 1;
+        fingerprints_.assign(3 * block_length_, 0);
+        for (seed_ = 1; seed_ <= kMaxSeeds; ++seed_) {
+            if (build(keys)) {
+                return;
+            }
+        }
+        throw BloomFilterException("cannot build xor filter");
+    }
+
+    bool search(uint64_t key) const {
+        uint64_t hash = mixHash(key + seed_);
+        Fingerprint f = fingerprint(hash);
+        return f == (fingerprints_[cell(hash, 0)] ^ fingerprints_[cell(hash, 1)] ^
+                     fingerprints_[cell(hash, 2)]);
+    }
+
+    uint64_t getSizeInBits() const { return fingerprints_.size() * sizeof(Fingerprint) * 8; }
+
+private:
+    static const uint64_t kMaxSeeds = 100;
+
+    uint64_t seed_;
+    uint64_t block_length_;
+    std::vector<Fingerprint> fingerprints_;
+
+    static Fingerprint fingerprint(uint64_t hash) {
+        return static_cast<Fingerprint>(hash ^ (hash >> 32));
+    }
+
+    // Cell of the key in segment 0, 1 or 2
+    uint64_t cell(uint64_t hash, int segment) const {
+        uint64_t rotated =
+            segment == 0 ? hash : (hash << (21 * segment)) | (hash >> (64 - 21 * segment));
+        return fastRange(rotated, block_length_) + segment * block_length_;
+    }
+
+    bool build(const std::vector<uint64_t>& keys) {
+        const uint64_t cells = fingerprints_.size();
+        // For every cell: xor of the hashes of its keys and their count,
+        // side by side to take one cache miss per cell
+        struct Slot {
+            uint64_t xor_hash;
+            uint64_t count;
+        };
+        std::vector<Slot> slots(cells, Slot{0, 0});
+        for (uint64_t key : keys) {
+            uint64_t hash = mixHash(key + seed_);
+            for (int segment = 0; segment < 3; ++segment) {
+                Slot& slot = slots[cell(hash, segment)];
+                ++slot.count;
+                slot.xor_hash ^= hash;
+            }
+        }
+        std::vector<uint64_t> queue;
+        for (uint64_t c = 0; c < cells; ++c) {
+            if (slots[c].count == 1) {
+                queue.push_back(c);
+            }
+        }
+        // (hash, cell it owns) in peeling order
+        std::vector<std::pair<uint64_t, uint64_t>> order;
+        order.reserve(keys.size());
+        while (!queue.empty()) {
+            uint64_t c = queue.back();
+            queue.pop_back();
+            if (slots[c].count != 1) {
+                continue;
+            }
+            uint64_t hash = slots[c].xor_hash;
+            order.emplace_back(hash, c);
+            for (int segment = 0; segment < 3; ++segment) {
+                uint64_t other = cell(hash, segment);
+                --slots[other].count;
+                slots[other].xor_hash ^= hash;
+                if (slots[other].count == 1) {
+                    queue.push_back(other);
+                }
+            }
+        }
+        if (order.size() != keys.size()) {
+            return false;
+        }
+        std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+        for (uint64_t k = order.size(); k > 0; --k) {
+            uint64_t hash = order[k - 1].first;
+            uint64_t owned = order[k - 1].second;
+            Fingerprint value = fingerprint(hash);
+            for (int segment = 0; segment < 3; ++segment) {
+                uint64_t c = cell(hash, segment);
+                if (c != owned) {
+                    value ^= fingerprints_[c];
+                }
+            }
+            fingerprints_[owned] = value;
+        }
+        return true;
+    }
+};
+
 void skipSpaces(const std::string& line, uint64_t& pos) {
     while (pos < line.size() && std::isspace(line[pos])) {
         ++pos;
@@ -219,7 +894,7 @@ BloomFilter* getBloomFilter() {
             continue;
         }
         try {
-            filter = new BloomFilter(n, p);
+            filter = new BloomFilter(n, p, BloomLayout::kFlat, BloomHashing::kPrimes);
         }
         catch (const BloomFilterException&) {
             std::cout << "error\n";
@@ -231,51 +906,692 @@ BloomFilter* getBloomFilter() {
     return nullptr;
 }
 
+/* Подряд идущие add и подряд идущие search копятся и выполняются пакетами
+ * (addBatch / searchBatch). Ответы печатаются в порядке команд: пакет
+ * сбрасывается перед любой другой командой, ошибкой и print.
+ */
+class CommandBatch {
+public:
+    explicit CommandBatch(BloomFilter* filter) : filter_(filter), searching_(false) {
+    }
+
+    void add(uint64_t key) { push(key, false); }
+    void search(uint64_t key) { push(key, true); }
+
+    void flush() {
+        if (keys_.empty()) {
+            return;
+        }
+        if (searching_) {
+            found_.resize((keys_.size() + 63) / 64);
+            filter_->searchBatch(keys_.data(), keys_.size(), found_.data());
+            for (uint64_t j = 0; j < keys_.size(); ++j) {
+                std::cout << ((found_[j / 64] >> (j % 64) & 1) ? "1\n" : "0\n");
+            }
+        } else {
+            filter_->addBatch(keys_.data(), keys_.size());
+        }
+        keys_.clear();
+    }
+
+private:
+    static const uint64_t kMaxKeys = 4096;
+
+    BloomFilter* filter_;
+    bool searching_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint64_t> found_;
+
+    void push(uint64_t key, bool searching) {
+        if (searching != searching_ || keys_.size() == kMaxKeys) {
+            flush();
+            searching_ = searching;
+        }
+        keys_.push_back(key);
+    }
+};
+
 void execCommands(BloomFilter* filter) {
     std::string line;
     std::string op;
     uint64_t pos, key;
+    CommandBatch batch(filter);
     while (std::getline(std::cin, line)) {
         if (line.size() == 0) {
             continue;
         }
         if (line == "print") {
+            batch.flush();
             std::cout << *filter << "\n";
             continue;
         }
         op = line.substr(0, 4);
         if (op == "add ") {
             pos = 4;
-            if (!getOneUint64_t(line, key, pos) || pos != line.size()) {
+            if (!getOneUint64_t(line, key, pos) || pos != line.size() || filter->isReadOnly()) {
+                batch.flush();
                 std::cout << "error\n";
                 continue;
             }
-            filter->add(key);
+            batch.add(key);
             continue;
         }
         op = line.substr(0, 7);
         if (op == "search ") {
             pos = 7;
             if (!getOneUint64_t(line, key, pos) || pos != line.size()) {
+                batch.flush();
                 std::cout << "error\n";
                 continue;
             }
-            std::cout << (filter->search(key) ? "1\n" : "0\n");
+            batch.search(key);
             continue;
         }
+        batch.flush();
         std::cout << "error\n";
     }
+    batch.flush();
+}
+
+// getOneUint64_t over [begin, end) that has to hold nothing but the number
+bool parseKey(const char* begin, const char* end, uint64_t& number) {
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin))) {
+        ++begin;
+    }
+    if (begin == end || !std::isdigit(static_cast<unsigned char>(*begin))) {
+        return false;
+    }
+    number = 0;
+    while (begin < end && std::isdigit(static_cast<unsigned char>(*begin))) {
+        number = number * 10 + (*begin - '0');
+        ++begin;
+    }
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin))) {
+        ++begin;
+    }
+    return begin == end;
+}
+
+/* Конвейер для того же протокола, что и execCommands, на миллионы команд в
+ * секунду. Поток чтения режет вход на блоки по kChunkSize байт по границе
+ * строки. Разборщики независимо превращают блоки в пакеты: для каждой add и
+ * search сразу считаются все k индексов битов и раскладываются по шардам.
+ * Шард - непрерывный кусок BitArray, кратный кэш-линии, у каждого шарда
+ * свой поток-владелец, и в его слова пишет только он, так что атомарные
+ * операции не нужны. Владелец проходит пакеты строго по порядку, поэтому
+ * его биты в момент search те же, что при последовательном исполнении, а
+ * ответ search - И по всем шардам. Поток вывода собирает ответы пакетов по
+ * порядку, и вывод совпадает с execCommands байт в байт. На print все
+ * владельцы останавливаются, пока фильтр не напечатан.
+ * По памяти: O(kMaxInFlight * kChunkSize * k) на пакеты в работе.
+ */
+class CommandPipeline {
+public:
+    CommandPipeline(BloomFilter* filter, unsigned parsers, unsigned shards);
+
+    void run(std::istream& in, std::ostream& out);
+
+private:
+    static const uint64_t kChunkSize = 1 << 20;
+    static const uint64_t kMaxInFlight = 16;
+    // Probes ahead of the current one whose words are already being loaded
+    static const uint64_t kPrefetchDistance = 16;
+
+    enum Command : uint8_t { kAdd, kSearch, kPrint, kError };
+
+    // A bit of an add or a search in the shard of the bit, or a print barrier
+    struct Probe {
+        uint64_t bit;
+        uint32_t command;
+        Command type;
+    };
+
+    struct Batch {
+        std::string text;
+        bool parsed = false;
+        unsigned applied = 0;
+        std::vector<Command> commands;
+        std::vector<std::vector<Probe>> probes;
+        // missing[shard * commands.size() + c] - a zero bit of search c in the shard
+        std::vector<uint8_t> missing;
+    };
+
+    BloomFilter* filter_;
+    unsigned parsers_;
+    unsigned shards_;
+    uint64_t shard_bits_;
+
+    // One lock for the batch counters; it is taken a few times per batch only
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::unique_ptr<Batch>> slots_;
+    uint64_t read_;
+    uint64_t parsing_;
+    uint64_t written_;
+    bool finished_;
+    // Owners that stopped at a print and prints done, over the whole run
+    uint64_t arrived_;
+    uint64_t printed_;
+
+    Batch& slot(uint64_t seq) { return *slots_[seq % kMaxInFlight]; }
+    void push(std::unique_ptr<Batch>);
+    void parse();
+    void parseLine(Batch&, const char*, const char*) const;
+    void own(unsigned shard);
+    void write(std::ostream&);
+    void reply(const Batch&, uint64_t, uint64_t, std::string&) const;
+
+    template <class Ready>
+    void waitFor(Ready ready) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, ready);
+    }
+    template <class Change>
+    void update(Change change) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            change();
+        }
+        changed_.notify_all();
+    }
+};
+
+CommandPipeline::CommandPipeline(BloomFilter* filter, unsigned parsers, unsigned shards)
+    : filter_(filter), parsers_(std::max(1U, parsers)), shards_(std::max(1U, shards)),
+      slots_(kMaxInFlight), read_(0), parsing_(0), written_(0), finished_(false),
+      arrived_(0), printed_(0) {
+    uint64_t lines = (filter_->getSize() + BitArray::kLineBits - 1) / BitArray::kLineBits;
+    shard_bits_ = std::max<uint64_t>(1, (lines + shards_ - 1) / shards_) * BitArray::kLineBits;
+}
+
+void CommandPipeline::run(std::istream& in, std::ostream& out) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < parsers_; ++i) {
+        threads.emplace_back([this] { parse(); });
+    }
+    for (unsigned shard = 0; shard < shards_; ++shard) {
+        threads.emplace_back([this, shard] { own(shard); });
+    }
+    threads.emplace_back([this, &out] { write(out); });
+
+    std::string rest;
+    while (in) {
+        std::unique_ptr<Batch> batch(new Batch);
+        batch->text.swap(rest);
+        uint64_t old_size = batch->text.size();
+        batch->text.resize(old_size + kChunkSize);
+        in.read(&batch->text[old_size], kChunkSize);
+        batch->text.resize(old_size + in.gcount());
+        if (in) {
+            // The unfinished last line goes to the next block
+            std::size_t end = batch->text.rfind('\n');
+            if (end == std::string::npos) {
+                rest.swap(batch->text);
+                continue;
+            }
+            rest.assign(batch->text, end + 1, std::string::npos);
+            batch->text.resize(end + 1);
+        }
+        if (!batch->text.empty()) {
+            push(std::move(batch));
+        }
+    }
+    update([this] { finished_ = true; });
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    out.flush();
+}
+
+void CommandPipeline::push(std::unique_ptr<Batch> batch) {
+    waitFor([this] { return read_ - written_ < kMaxInFlight; });
+    update([&] {
+        slots_[read_ % kMaxInFlight] = std::move(batch);
+        ++read_;
+    });
+}
+
+void CommandPipeline::parse() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return parsing_ < read_ || finished_; });
+        if (parsing_ == read_) {
+            return;
+        }
+        uint64_t seq = parsing_++;
+        lock.unlock();
+
+        Batch& batch = slot(seq);
+        batch.probes.resize(shards_);
+        const char* line = batch.text.data();
+        const char* end = line + batch.text.size();
+        while (line < end) {
+            const char* stop = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            if (stop == nullptr) {
+                stop = end;
+            }
+            parseLine(batch, line, stop);
+            line = stop + 1;
+        }
+        batch.missing.assign(shards_ * batch.commands.size(), 0);
+        update([&] { batch.parsed = true; });
+    }
+}
+
+void CommandPipeline::parseLine(Batch& batch, const char* begin, const char* end) const {
+    if (begin == end) {
+        return;
+    }
+    uint32_t command = batch.commands.size();
+    uint64_t length = end - begin;
+    if (length == 5 && std::memcmp(begin, "print", 5) == 0) {
+        batch.commands.push_back(kPrint);
+        for (std::vector<Probe>& probes : batch.probes) {
+            probes.push_back({0, command, kPrint});
+        }
+        return;
+    }
+    Command type = kError;
+    uint64_t key = 0;
+    if (length >= 4 && std::memcmp(begin, "add ", 4) == 0) {
+        if (parseKey(begin + 4, end, key) && !filter_->isReadOnly()) {
+            type = kAdd;
+        }
+    } else if (length >= 7 && std::memcmp(begin, "search ", 7) == 0) {
+        if (parseKey(begin + 7, end, key)) {
+            type = kSearch;
+        }
+    }
+    batch.commands.push_back(type);
+    if (type == kError) {
+        return;
+    }
+    filter_->forEachBit(key, [&](uint64_t bit) {
+        batch.probes[bit / shard_bits_].push_back({bit, command, type});
+        return true;
+    });
+}
+
+void CommandPipeline::own(unsigned shard) {
+    BitArray* bits = filter_->bit_array_;
+    uint64_t prints = 0;
+    for (uint64_t seq = 0;; ++seq) {
+        bool done = false;
+        waitFor([&] {
+            done = finished_ && seq == read_;
+            return done || (seq < read_ && slot(seq).parsed);
+        });
+        if (done) {
+            return;
+        }
+        Batch& batch = slot(seq);
+        const std::vector<Probe>& probes = batch.probes[shard];
+        uint8_t* missing = batch.missing.data() + shard * batch.commands.size();
+        for (uint64_t i = 0; i < probes.size(); ++i) {
+            if (i + kPrefetchDistance < probes.size()) {
+                const Probe& ahead = probes[i + kPrefetchDistance];
+                bits->prefetch(ahead.bit, ahead.type == kAdd);
+            }
+            const Probe& probe = probes[i];
+            if (probe.type == kAdd) {
+                bits->setBit(probe.bit);
+            } else if (probe.type == kSearch) {
+                if (!bits->isBitOne(probe.bit)) {
+                    missing[probe.command] = 1;
+                }
+            } else {
+                update([this] { ++arrived_; });
+                waitFor([&] { return printed_ > prints; });
+                ++prints;
+            }
+        }
+        update([&] { ++batch.applied; });
+    }
+}
+
+void CommandPipeline::write(std::ostream& out) {
+    std::string buffer;
+    uint64_t prints = 0;
+    for (uint64_t seq = 0;; ++seq) {
+        bool done = false;
+        waitFor([&] {
+            done = finished_ && seq == read_;
+            return done || (seq < read_ && slot(seq).parsed);
+        });
+        if (done) {
+            return;
+        }
+        Batch& batch = slot(seq);
+        uint64_t replied = 0;
+        for (uint64_t c = 0; c < batch.commands.size(); ++c) {
+            if (batch.commands[c] != kPrint) {
+                continue;
+            }
+            waitFor([&] { return arrived_ >= shards_ * (prints + 1); });
+            reply(batch, replied, c, buffer);
+            replied = c + 1;
+            out << buffer << *filter_ << "\n";
+            buffer.clear();
+            ++prints;
+            update([this] { ++printed_; });
+        }
+        waitFor([&] { return batch.applied == shards_; });
+        reply(batch, replied, batch.commands.size(), buffer);
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+        update([&] {
+            slots_[seq % kMaxInFlight].reset();
+            ++written_;
+        });
+    }
+}
+
+// Answers of commands [from, to) of the batch, none of them a print
+void CommandPipeline::reply(const Batch& batch, uint64_t from, uint64_t to,
+                            std::string& out) const {
+    uint64_t size = batch.commands.size();
+    for (uint64_t c = from; c < to; ++c) {
+        if (batch.commands[c] == kError) {
+            out += "error\n";
+        } else if (batch.commands[c] == kSearch) {
+            bool found = true;
+            for (unsigned shard = 0; shard < shards_ && found; ++shard) {
+                found = batch.missing[shard * size + c] == 0;
+            }
+            out += found ? "1\n" : "0\n";
+        }
+    }
+}
+
+std::string filterName(const BloomFilter& filter) {
+    if (filter.getLayout() == BloomLayout::kBlocked) {
+        return "blocked";
+    }
+    return filter.getHashing() == BloomHashing::kPrimes ? "flat primes" : "flat double";
 }
 
-int main() {
+/* Сравнение режимов на n случайных ключах: скорость add и search (млн
+ * ключей в секунду), поштучно и пакетами, и доля ложных срабатываний на n
+ * ключах, которых нет. Ключи порождаются кусками, чтобы память уходила на
+ * фильтр и можно было мерить фильтры больше кэша последнего уровня.
+ * Запуск: mr_Bloom bench [n] [p]
+ */
+void benchmark(uint64_t n, double p) {
+    const uint64_t chunk = 1 << 16;
+    std::vector<uint64_t> keys(chunk);
+    std::vector<uint64_t> found(chunk / 64);
+    // Calls run(keys, count) for all n keys chunk by chunk, returns seconds
+    auto timed = [&](bool present, auto run) {
+        double total = 0;
+        for (uint64_t first = 0; first < n; first += chunk) {
+            uint64_t count = std::min(chunk, n - first);
+            for (uint64_t i = 0; i < count; ++i) {
+                keys[i] = mixHash(2 * (first + i) + (present ? 0 : 1));
+            }
+            auto start = std::chrono::steady_clock::now();
+            run(keys.data(), count);
+            total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return total;
+    };
+    const std::pair<BloomLayout, BloomHashing> modes[] = {
+        {BloomLayout::kFlat, BloomHashing::kPrimes},
+        {BloomLayout::kFlat, BloomHashing::kDouble},
+        {BloomLayout::kBlocked, BloomHashing::kDouble},
+    };
+    for (const auto& mode : modes) {
+        BloomFilter filter(n, p, mode.first, mode.second);
+        uint64_t false_positives = 0;
+        double add_time = timed(true, [&](const uint64_t* keys, uint64_t count) {
+            for (uint64_t i = 0; i < count; ++i) {
+                filter.add(keys[i]);
+            }
+        });
+        double search_time = timed(false, [&](const uint64_t* keys, uint64_t count) {
+            for (uint64_t i = 0; i < count; ++i) {
+                false_positives += filter.search(keys[i]);
+            }
+        });
+        // The same keys again, the bits are already set
+        double add_batch_time = timed(true, [&](const uint64_t* keys, uint64_t count) {
+            filter.addBatch(keys, count);
+        });
+        double search_batch_time = timed(false, [&](const uint64_t* keys, uint64_t count) {
+            filter.searchBatch(keys, count, found.data());
+        });
+
+        std::cout << filterName(filter) << ": " << filter.getSize() / 8 / 1024 / 1024
+                  << " MiB, add " << n / add_time / 1e6 << " M/s (batch "
+                  << n / add_batch_time / 1e6 << "), search " << n / search_time / 1e6
+                  << " M/s (batch " << n / search_batch_time / 1e6 << "), false positives "
+                  << static_cast<double>(false_positives) / n << "\n";
+    }
+}
+
+/* Параллельная вставка n ключей в общий фильтр: скорость при 1, 2, 4, ...
+ * потоках, затем проверка, что каждый вставленный ключ находится (потерянная
+ * из-за гонки вставка дала бы ложноотрицательный ответ).
+ * Возвращает false, если хоть одна вставка потерялась.
+ * Запуск: mr_Bloom bench-threads [n] [max_threads]
+ */
+bool benchmarkThreads(uint64_t n, unsigned max_threads) {
+    bool all_found = true;
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        BloomFilter filter(n, 0.01, BloomLayout::kBlocked);
+        filter.setConcurrent(true);
+        auto work = [&](unsigned t, bool inserting, uint64_t* missing) {
+            for (uint64_t i = t; i < n; i += threads) {
+                if (inserting) {
+                    filter.add(mixHash(i));
+                } else if (!filter.search(mixHash(i))) {
+                    ++*missing;
+                }
+            }
+        };
+        std::vector<uint64_t> missing(threads, 0);
+        double seconds[2];
+        for (int inserting = 1; inserting >= 0; --inserting) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads; ++t) {
+                pool.emplace_back(work, t, inserting == 1, &missing[t]);
+            }
+            for (std::thread& thread : pool) {
+                thread.join();
+            }
+            seconds[inserting] =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        uint64_t lost = 0;
+        for (uint64_t count : missing) {
+            lost += count;
+        }
+        std::cout << threads << " threads: add " << n / seconds[1] / 1e6 << " M/s, search "
+                  << n / seconds[0] / 1e6 << " M/s, lost inserts " << lost << "\n";
+        all_found = all_found && lost == 0;
+    }
+    return all_found;
+}
+
+/* Варианты фильтра: масштабируемый на 8n ключах при расчете на n
+ * (оценка ошибки против измеренной по мере роста), и считающий - n ключей,
+ * удаление половины, проверка, что оставшиеся находятся, и ошибка до и после.
+ * Запуск: mr_Bloom bench-variants [n] [p]
+ */
+void benchmarkVariants(uint64_t n, double p) {
+    auto measured = [n](auto& filter) {
+        uint64_t false_positives = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            false_positives += filter.search(mixHash(2 * i + 1));
+        }
+        return static_cast<double>(false_positives) / n;
+    };
+    ScalableBloomFilter scalable(n, p);
+    for (uint64_t i = 0; i < 8 * n; ++i) {
+        scalable.add(mixHash(2 * i));
+        if ((i + 1) % n == 0) {
+            std::cout << "scalable, " << (i + 1) / n << "n keys, " << scalable.getNumberFilters()
+                      << " filters: estimated " << scalable.estimatedFalsePositiveRate()
+                      << ", measured " << measured(scalable) << "\n";
+        }
+    }
+
+    CountingBloomFilter counting(n, p);
+    for (uint64_t i = 0; i < n; ++i) {
+        counting.add(mixHash(2 * i));
+    }
+    std::cout << "counting, n keys: estimated " << counting.estimatedFalsePositiveRate()
+              << ", measured " << measured(counting) << "\n";
+    for (uint64_t i = 0; i < n; i += 2) {
+        counting.remove(mixHash(2 * i));
+    }
+    uint64_t lost = 0;
+    for (uint64_t i = 1; i < n; i += 2) {
+        lost += !counting.search(mixHash(2 * i));
+    }
+    std::cout << "counting, half removed: estimated " << counting.estimatedFalsePositiveRate()
+              << ", measured " << measured(counting) << ", lost keys " << lost << "\n";
+}
+
+/* Xor-фильтр против BloomFilter при равной ошибке: 8-битный отпечаток против
+ * p = 2^-8, 16-битный против p = 2^-16. Память на ключ, время построения
+ * (для BloomFilter - n вызовов add), скорость search на отсутствующих
+ * ключах и измеренная ошибка.
+ * Запуск: mr_Bloom bench-xor [n]
+ */
+void benchmarkXor(uint64_t n) {
+    std::vector<uint64_t> keys(n);
+    std::vector<uint64_t> absent(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        keys[i] = mixHash(2 * i);
+        absent[i] = mixHash(2 * i + 1);
+    }
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [&](const std::string& name, const auto& filter, uint64_t bits,
+                      double build_time) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t false_positives = 0;
+        for (uint64_t key : absent) {
+            false_positives += filter.search(key);
+        }
+        double search_time = seconds(start);
+        std::cout << name << ": " << static_cast<double>(bits) / n << " bits/key, build "
+                  << build_time << " s, search " << n / search_time / 1e6
+                  << " M/s, false positives " << static_cast<double>(false_positives) / n
+                  << "\n";
+    };
+    for (int bits : {8, 16}) {
+        double p = std::ldexp(1.0, -bits);
+        for (BloomLayout layout : {BloomLayout::kFlat, BloomLayout::kBlocked}) {
+            auto start = std::chrono::steady_clock::now();
+            BloomFilter bloom(n, p, layout);
+            bloom.addBatch(keys.data(), n);
+            double build_time = seconds(start);
+            report(std::string(layout == BloomLayout::kFlat ? "bloom" : "blocked bloom") +
+                       " p=2^-" + std::to_string(bits),
+                   bloom, bloom.getSize(), build_time);
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (bits == 8) {
+            XorFilter<uint8_t> filter(keys);
+            report("xor8", filter, filter.getSizeInBits(), seconds(start));
+        } else {
+            XorFilter<uint16_t> filter(keys);
+            report("xor16", filter, filter.getSizeInBits(), seconds(start));
+        }
+    }
+}
+
+const unsigned kMaxThreads = 1024;
+
+// Thread count from the command line, 0 if it is not a number in [1, kMaxThreads]
+unsigned parseThreads(const std::string& arg) {
+    unsigned threads = 0;
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), threads);
+    if (error != std::errc() || end != arg.data() + arg.size() || threads > kMaxThreads) {
+        return 0;
+    }
+    return threads;
+}
+
+int main(int argc, char* argv[]) {
     std::ios_base::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
-    BloomFilter* filter = getBloomFilter();
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? std::stoull(argv[2]) : 10000000, argc > 3 ? std::stod(argv[3]) : 0.01);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-variants") {
+        benchmarkVariants(argc > 2 ? std::stoull(argv[2]) : 1000000,
+                          argc > 3 ? std::stod(argv[3]) : 0.01);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-xor") {
+        benchmarkXor(argc > 2 ? std::stoull(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-threads") {
+        uint64_t n = 10000000;
+        if (argc > 2) {
+            std::string arg = argv[2];
+            auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), n);
+            n = error == std::errc() && end == arg.data() + arg.size() ? n : 0;
+        }
+        unsigned threads = argc > 3 ? parseThreads(argv[3])
+                                    : std::max(1U, std::thread::hardware_concurrency());
+        // With no keys or no threads nothing would be checked and the run would pass
+        if (n == 0 || threads == 0) {
+            std::cerr << "usage: " << argv[0] << " bench-threads [n] [max_threads], n above 0, "
+                      << "max_threads from 1 to " << kMaxThreads << "\n";
+            return 1;
+        }
+        return benchmarkThreads(n, threads) ? 0 : 1;
+    }
+
+    // "open <file>" - commands against a saved filter mapped read-only,
+    // "save <file>" - the usual session, then the filter is written to the file,
+    // "pipeline [threads]" - the usual session through CommandPipeline
+    unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+    if (argc > 2 && std::string(argv[1]) == "pipeline") {
+        threads = parseThreads(argv[2]);
+        if (threads == 0) {
+            std::cerr << "usage: " << argv[0] << " pipeline [threads], threads from 1 to "
+                      << kMaxThreads << "\n";
+            return 1;
+        }
+    }
+    BloomFilter* filter = nullptr;
+    if (argc > 2 && std::string(argv[1]) == "open") {
+        try {
+            filter = BloomFilter::open(argv[2]);
+        }
+        catch (BloomFilterException& exception) {
+            std::cout << exception.getMessage() << "\n";
+            return 1;
+        }
+    } else {
+        filter = getBloomFilter();
+    }
     if (filter == nullptr) {
         return 0;
     }
-    execCommands(filter);
+    if (argc > 1 && std::string(argv[1]) == "pipeline") {
+        CommandPipeline pipeline(filter, threads - threads / 2, threads / 2);
+        pipeline.run(std::cin, std::cout);
+    } else {
+        execCommands(filter);
+    }
+    if (argc > 2 && std::string(argv[1]) == "save") {
+        try {
+            filter->save(argv[2]);
+        }
+        catch (BloomFilterException& exception) {
+            std::cout << exception.getMessage() << "\n";
+        }
+    }
     delete filter;
 
     return 0;
@@ -0,0 +1,60 @@
+import random
+import subprocess
+import sys
+import time
+
+# Usage: python3 stress_003640.py ./003640 [n]
+# Runs the solver on n random items for every DP mode and checks the answer.
+
+MODES = {
+    # name: (capacity, max weight, costs, max n)
+    'table': (30, 100, 'random', None),
+    'rolling': (5000, 100000, 'random', None),
+    'subset-sum': (100000, 1000000, 'weight', None),
+    'huge W': (10 ** 12, 10 ** 12, 'random', None),
+    # weights from max / 3, cost = weight + 1000: the search gives up, rows finish
+    'correlated': (10 ** 7, 30000, 'correlated', 1000),
+}
+
+
+def make_item(rnd, max_weight, costs):
+    if costs == 'correlated':
+        weight = rnd.randint(max_weight // 3, max_weight)
+        return weight, weight + 1000
+    weight = rnd.randint(1, max_weight)
+    return weight, weight if costs == 'weight' else rnd.randint(0, max_weight)
+
+
+def run(binary, n, capacity, max_weight, costs):
+    rnd = random.Random(n)
+    items = [make_item(rnd, max_weight, costs) for _ in range(n)]
+    data = '%d\n%s\nend\n' % (capacity, '\n'.join('%d %d' % item for item in items))
+
+    start = time.time()
+    result = subprocess.run([binary], input=data, capture_output=True, text=True)
+    elapsed = time.time() - start
+    if result.returncode != 0:
+        return 'crashed with code %d' % result.returncode, elapsed
+
+    lines = result.stdout.split()
+    total_weight, total_cost = int(lines[0]), int(lines[1])
+    numbers = [int(number) for number in lines[2:]]
+    weight = sum(items[number - 1][0] for number in numbers)
+    cost = sum(items[number - 1][1] for number in numbers)
+    if weight != total_weight or cost != total_cost or weight > capacity:
+        return 'wrong answer', elapsed
+    if numbers != sorted(set(numbers)):
+        return 'numbers not sorted', elapsed
+    return 'ok', elapsed
+
+
+if __name__ == '__main__':
+    binary = sys.argv[1]
+    n = int(sys.argv[2]) if len(sys.argv) > 2 else 10 ** 6
+    failed = False
+    for name, (capacity, max_weight, costs, max_n) in MODES.items():
+        size = min(n, max_n) if max_n else n
+        status, elapsed = run(binary, size, capacity, max_weight, costs)
+        print('%-10s n=%d %s %.2fs' % (name, size, status, elapsed))
+        failed = failed or status != 'ok'
+    sys.exit(1 if failed else 0)